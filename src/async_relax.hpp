@@ -0,0 +1,271 @@
+#pragma once
+
+#include <mpi.h>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "logger.hpp"
+#include "parse_data.hpp"
+
+/// @brief What every process contributes to a termination wave of the asynchronous engine.
+struct WaveState
+{
+    /// @brief relaxation batches sent and received by this process so far (summed)
+    long long sent;
+    long long received;
+    /// @brief 1 if the process still has queued vertices (summed)
+    long long busy;
+    /// @brief smallest queued bucket (minimum); the processing window of every process starts at it
+    long long minBucket;
+};
+
+/// @brief Counting termination detection over consecutive waves (the four-counter method).
+/// The contributions to one wave are taken at different times, so a wave with `sent == received` may still miss a
+/// batch sent after its sender contributed and received before its receiver did. A process contributes to wave
+/// `k + 1` only after wave `k` completed, i.e. after everybody contributed to it. If two consecutive waves count the
+/// same batches, no process sent or received anything between its two contributions (counters only grow), so at the
+/// moment the earlier wave completed no batch was in flight; with every process idle at the later wave, none can
+/// get work again.
+class TerminationDetector
+{
+    bool hasPrevious = false;
+    long long prevSent = 0;
+    long long prevReceived = 0;
+
+public:
+    /// @param global result of the latest wave
+    /// @returns true once the computation is over everywhere
+    bool observe(const WaveState &global)
+    {
+        bool done = hasPrevious && global.busy == 0 && global.sent == global.received &&
+                    global.sent == prevSent && global.received == prevReceived;
+        hasPrevious = true;
+        prevSent = global.sent;
+        prevReceived = global.received;
+        return done;
+    }
+};
+
+/// @brief Non-blocking Allreduce of `WaveState`: started when the previous wave completed, tested between
+/// relaxations, so a process never waits for the others.
+class WaveReduction
+{
+    MPI_Comm comm;
+    MPI_Datatype type;
+    MPI_Op op;
+    MPI_Request request;
+    WaveState local;
+    WaveState global;
+    unsigned long long nWaves;
+
+    static void combine(void *in, void *inout, int *len, MPI_Datatype *)
+    {
+        auto *a = static_cast<const WaveState *>(in);
+        auto *b = static_cast<WaveState *>(inout);
+        for (int i = 0; i < *len; ++i)
+        {
+            b[i].sent += a[i].sent;
+            b[i].received += a[i].received;
+            b[i].busy += a[i].busy;
+            b[i].minBucket = std::min(b[i].minBucket, a[i].minBucket);
+        }
+    }
+
+public:
+    explicit WaveReduction(MPI_Comm comm_)
+        : comm(comm_),
+          type(MPI_DATATYPE_NULL),
+          op(MPI_OP_NULL),
+          request(MPI_REQUEST_NULL),
+          local{0, 0, 0, 0},
+          global{0, 0, 0, std::numeric_limits<long long>::max()},
+          nWaves(0)
+    {
+        static_assert(sizeof(WaveState) == 4 * sizeof(long long), "WaveState must be four packed long longs");
+        MPI_CALL(MPI_Type_contiguous(4, MPI_LONG_LONG, &type));
+        MPI_CALL(MPI_Type_commit(&type));
+        MPI_CALL(MPI_Op_create(&WaveReduction::combine, 1, &op));
+    }
+
+    WaveReduction(const WaveReduction &) = delete;
+    WaveReduction &operator=(const WaveReduction &) = delete;
+
+    ~WaveReduction()
+    {
+        if (request != MPI_REQUEST_NULL)
+        {
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
+        }
+        MPI_Op_free(&op);
+        MPI_Type_free(&type);
+    }
+
+    bool inFlight() const
+    {
+        return request != MPI_REQUEST_NULL;
+    }
+
+    void start(const WaveState &state)
+    {
+        local = state;
+        MPI_CALL(MPI_Iallreduce(&local, &global, 1, type, op, comm, &request));
+        nWaves++;
+    }
+
+    /// @returns result of the wave in flight once every process contributed to it, else nullptr
+    const WaveState *test()
+    {
+        int done = 0;
+        MPI_CALL(MPI_Test(&request, &done, MPI_STATUS_IGNORE));
+        return done ? &global : nullptr;
+    }
+
+    unsigned long long getNWaves() const
+    {
+        return nWaves;
+    }
+};
+
+/// @brief Relaxations for remote vertices, buffered per owner and sent in batches with `MPI_Isend` once
+/// `batchSize` of them are waiting (or on `flush`). Incoming batches are found with `MPI_Iprobe` on `poll`.
+class RelaxBatches
+{
+public:
+    static constexpr int TAG = 1;
+
+private:
+    MPI_Comm comm;
+    size_t batchSize;
+    std::vector<std::vector<RelaxMessage>> outbox;
+    /// @brief buffers of the sends in flight, `requests[i]` sending `sending[i]`
+    std::vector<std::vector<RelaxMessage>> sending;
+    std::vector<MPI_Request> requests;
+    /// @brief buffers of completed sends, reused for the outboxes
+    std::vector<std::vector<RelaxMessage>> spare;
+    std::vector<RelaxMessage> incoming;
+    long long nSent;
+    long long nReceived;
+    unsigned long long nRelaxationsSent;
+
+    void send(int owner)
+    {
+        auto &box = outbox[owner];
+        sending.push_back(std::move(box));
+        requests.push_back(MPI_REQUEST_NULL);
+        const auto &buffer = sending.back();
+        MPI_CALL(MPI_Isend(buffer.data(), static_cast<int>(2 * buffer.size()), MPI_LONG_LONG, owner, TAG, comm,
+                           &requests.back()));
+        nSent++;
+        nRelaxationsSent += buffer.size();
+        box.clear();
+        if (!spare.empty())
+        {
+            box = std::move(spare.back());
+            spare.pop_back();
+        }
+    }
+
+    /// @brief Release the buffers of completed sends
+    void reapSends()
+    {
+        for (size_t i = 0; i < requests.size();)
+        {
+            int done = 0;
+            MPI_CALL(MPI_Test(&requests[i], &done, MPI_STATUS_IGNORE));
+            if (!done)
+            {
+                ++i;
+                continue;
+            }
+            sending[i].clear();
+            spare.push_back(std::move(sending[i]));
+            std::swap(sending[i], sending.back());
+            std::swap(requests[i], requests.back());
+            sending.pop_back();
+            requests.pop_back();
+        }
+    }
+
+public:
+    RelaxBatches(MPI_Comm comm_, int nProcessors, size_t batchSize_)
+        : comm(comm_), batchSize(std::max<size_t>(1, batchSize_)), outbox(nProcessors),
+          nSent(0), nReceived(0), nRelaxationsSent(0)
+    {
+    }
+
+    RelaxBatches(const RelaxBatches &) = delete;
+    RelaxBatches &operator=(const RelaxBatches &) = delete;
+
+    void push(int owner, long long indexAtOwner, long long newDist)
+    {
+        auto &box = outbox[owner];
+        box.push_back({indexAtOwner, newDist});
+        if (box.size() >= batchSize)
+        {
+            send(owner);
+        }
+    }
+
+    /// @brief Send every partial batch
+    void flush()
+    {
+        for (size_t owner = 0; owner < outbox.size(); ++owner)
+        {
+            if (!outbox[owner].empty())
+            {
+                send(static_cast<int>(owner));
+            }
+        }
+    }
+
+    /// @brief Call `apply(msg)` for every relaxation of every batch that has arrived
+    template <typename Fn>
+    void poll(Fn &&apply)
+    {
+        reapSends();
+        while (true)
+        {
+            int arrived = 0;
+            MPI_Status status;
+            MPI_CALL(MPI_Iprobe(MPI_ANY_SOURCE, TAG, comm, &arrived, &status));
+            if (!arrived)
+            {
+                return;
+            }
+            int count = 0;
+            MPI_CALL(MPI_Get_count(&status, MPI_LONG_LONG, &count));
+            incoming.resize(count / 2);
+            MPI_CALL(MPI_Recv(incoming.data(), count, MPI_LONG_LONG, status.MPI_SOURCE, TAG, comm, MPI_STATUS_IGNORE));
+            nReceived++;
+            for (const auto &msg : incoming)
+            {
+                apply(msg);
+            }
+        }
+    }
+
+    /// @brief Wait for the sends still in flight; after termination every one of them has been received
+    void finish()
+    {
+        MPI_CALL(MPI_Waitall(static_cast<int>(requests.size()), requests.data(), MPI_STATUSES_IGNORE));
+        sending.clear();
+        requests.clear();
+    }
+
+    long long getNSent() const
+    {
+        return nSent;
+    }
+
+    long long getNReceived() const
+    {
+        return nReceived;
+    }
+
+    unsigned long long getNRelaxationsSent() const
+    {
+        return nRelaxationsSent;
+    }
+};
@@ -0,0 +1,241 @@
+// Micro-benchmark of the relaxation inner loop on a synthetic single-rank graph.
+// For every phase kind it reports relaxed edges/s of the original loop (all edges of a vertex walked, each tested
+// by a run-time `std::function` predicate and handed to a `std::function` visitor) against `relaxActiveRange`, the
+// loop `relaxAllEdges` runs (weight-sorted edge range picked per vertex, subset and visitor as template parameters).
+// Both relax into a local array instead of communicating, so only the loop itself is measured.
+//
+// Usage: mpirun -n 1 ./bench_relax [nVertices] [avgDegree] [maxWeight] [delta] [repeats]
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <functional>
+#include <mpi.h>
+
+#include "block_dist.hpp"
+#include "parse_data.hpp"
+#include "relax_kernels.hpp"
+
+enum class Mode
+{
+    InnerShort,
+    Long,
+    All,
+    BellmanFord
+};
+
+/// @brief Every vertex is active in bucket `currentK` (its distance is stored in `Data`); `best` collects the
+/// smallest candidate per target
+struct Workload
+{
+    std::vector<size_t> active;
+    std::vector<long long> best;
+    long long currentK;
+    long long delta;
+};
+
+/// @brief The original loop: every edge of every active vertex is walked and a run-time `edgeConsidered`
+/// predicate, behind a `std::function` like the visitor, decides per edge whether it belongs to the phase
+using EdgePredicate = std::function<bool(size_t, size_t, long long)>;
+
+/// @brief `Data::forEachNeighborInRange` as it was before it took the visitor as a template parameter
+void forEachNeighborDynamic(const Data &data, size_t first, size_t last,
+                            const std::function<void(VertexRef, long long)> &visitor)
+{
+    const auto &targets = data.getAdjTargets();
+    const auto &weights = data.getAdjWeights();
+    for (size_t e = first; e < last; ++e)
+    {
+        visitor(targets[e], weights[e]);
+    }
+}
+
+EdgePredicate edgeConsidered(const Data &data, Mode mode, const Workload &work, size_t &nConsidered)
+{
+    auto isInnerShort = [&data, &work](size_t uGlobalIdx, size_t, long long weight) -> bool
+    {
+        auto uDist = data.getDist(uGlobalIdx);
+        return weight < work.delta && uDist + weight <= (work.currentK + 1) * work.delta - 1;
+    };
+    switch (mode)
+    {
+    case Mode::InnerShort:
+        return [isInnerShort, &nConsidered](size_t u, size_t v, long long w)
+        {
+            if (isInnerShort(u, v, w))
+            {
+                nConsidered++;
+                return true;
+            }
+            return false;
+        };
+    case Mode::Long:
+        return [isInnerShort, &nConsidered](size_t u, size_t v, long long w)
+        {
+            if (isInnerShort(u, v, w))
+            {
+                return false;
+            }
+            nConsidered++;
+            return true;
+        };
+    default:
+        return [&nConsidered](size_t, size_t, long long)
+        {
+            nConsidered++;
+            return true;
+        };
+    }
+}
+
+/// @returns number of edges relaxed
+size_t relaxDynamic(const Data &data, Mode mode, Workload &work)
+{
+    size_t nRelaxed = 0;
+    auto considered = edgeConsidered(data, mode, work, nRelaxed);
+    for (auto u : work.active)
+    {
+        auto uDist = data.getDist(u);
+        auto [first, last] = data.edgeRange(u);
+        forEachNeighborDynamic(data, first, last, [&](VertexRef v, long long w)
+        {
+            if (!considered(u, v.indexAtOwner(), w) || w >= INF - uDist)
+            {
+                return;
+            }
+            auto &slot = work.best[v.indexAtOwner()];
+            slot = std::min(slot, uDist + w);
+        });
+    }
+    return nRelaxed;
+}
+
+/// @returns number of edges relaxed
+template <EdgeSubset subset>
+size_t relaxShared(const Data &data, Workload &work)
+{
+    unsigned long long nShort = 0, nLong = 0;
+    relaxActiveRange<subset>(data, work.active, 0, work.active.size(), work.currentK, work.delta, nShort, nLong,
+                             [&](VertexRef v, long long newDist, int)
+                             {
+                                 auto &slot = work.best[v.indexAtOwner()];
+                                 slot = std::min(slot, newDist);
+                             });
+    return nShort + nLong;
+}
+
+size_t relaxShared(const Data &data, Mode mode, Workload &work)
+{
+    switch (mode)
+    {
+    case Mode::InnerShort:
+        return relaxShared<EdgeSubset::InnerShort>(data, work);
+    case Mode::Long:
+        return relaxShared<EdgeSubset::Long>(data, work);
+    default:
+        return relaxShared<EdgeSubset::All>(data, work);
+    }
+}
+
+/// @returns edges per second of the best of `repeats` runs
+template <typename Kernel>
+double measure(Kernel &&kernel, Workload &work, int repeats, long long &checksum)
+{
+    double best = 0;
+    for (int r = 0; r < repeats; ++r)
+    {
+        std::fill(work.best.begin(), work.best.end(), INF);
+        double start = MPI_Wtime();
+        auto nEdges = kernel();
+        double elapsed = MPI_Wtime() - start;
+        if (elapsed > 0)
+        {
+            best = std::max(best, nEdges / elapsed);
+        }
+    }
+    for (auto d : work.best)
+    {
+        checksum += d == INF ? 0 : d;
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    MPI_Init(&argc, &argv);
+    size_t nVertices = argc > 1 ? std::stoull(argv[1]) : 1 << 20;
+    size_t avgDegree = argc > 2 ? std::stoull(argv[2]) : 16;
+    long long maxWeight = argc > 3 ? std::stoll(argv[3]) : 255;
+    long long delta = argc > 4 ? std::stoll(argv[4]) : 32;
+    int repeats = argc > 5 ? std::stoi(argv[5]) : 5;
+
+    int nProcs;
+    MPI_Comm_size(MPI_COMM_WORLD, &nProcs);
+    if (nProcs != 1)
+    {
+        std::cerr << "bench_relax runs on a single rank" << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    {
+        Data data(0, nVertices, nVertices);
+        std::mt19937_64 rng(42);
+        std::uniform_int_distribution<size_t> vertex(0, nVertices - 1);
+        std::uniform_int_distribution<long long> weight(0, maxWeight);
+        for (size_t i = 0; i < nVertices * avgDegree / 2; ++i)
+        {
+            data.addEdgeFast(vertex(rng), vertex(rng), weight(rng));
+        }
+        data.finalizeAdjacency();
+        data.resolveTargets(BlockDistribution::Distribution(1, nVertices));
+
+        // every vertex active in bucket 8, as in a phase of a bucket a few hops from the root
+        Workload work;
+        work.best.assign(nVertices, INF);
+        std::uniform_int_distribution<long long> offset(0, delta - 1);
+        std::vector<long long> offsets;
+        for (size_t u = 0; u < nVertices; ++u)
+        {
+            work.active.push_back(u);
+            offsets.push_back(offset(rng));
+        }
+
+        std::cout << "Graph: " << nVertices << " vertices, " << data.getNLocalEdges() << " edge entries, weights <= "
+                  << maxWeight << ", delta " << delta << "\n";
+        std::cout << std::left << std::setw(14) << "mode" << std::right << std::setw(22) << "edgeConsidered [Me/s]"
+                  << std::setw(25) << "relaxActiveRange [Me/s]" << std::setw(10) << "speedup" << "\n";
+
+        const std::pair<Mode, const char *> modes[] = {
+            {Mode::InnerShort, "short"}, {Mode::Long, "long"}, {Mode::All, "noios"}, {Mode::BellmanFord, "bellman-ford"}};
+        long long checksumDynamic = 0, checksumStatic = 0;
+        for (auto [mode, name] : modes)
+        {
+            // Bellman-Ford relaxes everything as the single bucket 0 of width INF
+            work.delta = mode == Mode::BellmanFord ? INF : delta;
+            work.currentK = mode == Mode::BellmanFord ? 0 : 8;
+            for (size_t u = 0; u < nVertices; ++u)
+            {
+                data.updateDist(u, 8 * delta + offsets[u]);
+            }
+            data.splitByWeight(work.delta);
+            auto dynamicRate = measure([&]
+                                       { return relaxDynamic(data, mode, work); }, work, repeats, checksumDynamic);
+            auto staticRate = measure([&]
+                                      { return relaxShared(data, mode, work); }, work, repeats, checksumStatic);
+            std::cout << std::left << std::setw(14) << name << std::right << std::fixed << std::setprecision(1)
+                      << std::setw(22) << dynamicRate / 1e6 << std::setw(25) << staticRate / 1e6
+                      << std::setw(9) << std::setprecision(2) << (dynamicRate > 0 ? staticRate / dynamicRate : 0) << "x\n";
+        }
+        if (checksumDynamic != checksumStatic)
+        {
+            std::cerr << "Kernels disagree: " << checksumDynamic << " != " << checksumStatic << std::endl;
+            data.freeWindow();
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        data.freeWindow();
+    }
+    MPI_Finalize();
+    return 0;
+}
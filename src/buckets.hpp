@@ -0,0 +1,342 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+
+/// @brief Delta-stepping buckets of the vertices owned by one process.
+/// Buckets `[base, base + nSlots)` live in a cyclic array of slots indexed by `bucket % nSlots`; vertices in later
+/// buckets wait in a single overflow slot until the ring drains. Every vertex remembers its slot and position,
+/// so moving it between buckets is O(1) (swap with the last element and pop).
+class BucketQueue
+{
+public:
+    static constexpr long long NONE = std::numeric_limits<long long>::max();
+
+    class InvalidBucket : public std::runtime_error
+    {
+    public:
+        InvalidBucket(const std::string &what) : std::runtime_error(what) {}
+    };
+
+private:
+    size_t firstGlobalIdx;
+    size_t nSlots;
+    /// @brief per local vertex: its bucket (`NONE` if not queued), slot (`nSlots` = overflow) and position in the slot
+    std::vector<long long> bucketOf;
+    std::vector<size_t> slotOf;
+    std::vector<size_t> posOf;
+    /// @brief `nSlots` ring slots followed by the overflow slot
+    std::vector<std::vector<size_t>> slots;
+    long long base;
+    /// @brief no ring bucket below `cursor` is non-empty
+    long long cursor;
+    size_t nQueued;
+    /// @brief smallest bucket in the overflow slot, recomputed lazily after it leaves
+    mutable long long overflowMin;
+    mutable bool overflowMinValid;
+
+    size_t localIdx(size_t vGlobalIdx) const
+    {
+        if (vGlobalIdx < firstGlobalIdx || vGlobalIdx - firstGlobalIdx >= bucketOf.size())
+        {
+            throw InvalidBucket("Vertex not owned: " + std::to_string(vGlobalIdx));
+        }
+        return vGlobalIdx - firstGlobalIdx;
+    }
+
+    bool inRing(long long bucket) const
+    {
+        return bucket >= base && static_cast<unsigned long long>(bucket - base) < nSlots;
+    }
+
+    void detach(size_t local)
+    {
+        if (slotOf[local] == nSlots && bucketOf[local] == overflowMin)
+        {
+            overflowMinValid = false;
+        }
+        auto &slot = slots[slotOf[local]];
+        auto pos = posOf[local];
+        auto moved = slot.back();
+        slot[pos] = moved;
+        posOf[moved - firstGlobalIdx] = pos;
+        slot.pop_back();
+        bucketOf[local] = NONE;
+        nQueued--;
+    }
+
+    void attach(size_t local, long long bucket)
+    {
+        if (bucket < 0 || bucket == NONE)
+        {
+            throw InvalidBucket("Invalid bucket index: " + std::to_string(bucket));
+        }
+        if (bucket < base)
+        {
+            rebase(bucket);
+        }
+        auto slotIdx = inRing(bucket) ? static_cast<size_t>(bucket % static_cast<long long>(nSlots)) : nSlots;
+        bucketOf[local] = bucket;
+        slotOf[local] = slotIdx;
+        posOf[local] = slots[slotIdx].size();
+        slots[slotIdx].push_back(firstGlobalIdx + local);
+        nQueued++;
+        if (slotIdx == nSlots && overflowMinValid)
+        {
+            overflowMin = std::min(overflowMin, bucket);
+        }
+        if (bucket < cursor)
+        {
+            cursor = bucket;
+        }
+    }
+
+    /// @brief Re-place every queued vertex for a ring starting at `newBase`. O(queued); only needed when a
+    /// bucket below `base` is requested (e.g. collapsing everything into bucket 0 for Bellman-Ford).
+    void rebase(long long newBase)
+    {
+        std::vector<size_t> queued;
+        queued.reserve(nQueued);
+        for (auto &slot : slots)
+        {
+            queued.insert(queued.end(), slot.begin(), slot.end());
+            slot.clear();
+        }
+        base = newBase;
+        cursor = newBase;
+        nQueued = 0;
+        overflowMin = NONE;
+        overflowMinValid = true;
+        for (auto v : queued)
+        {
+            auto local = v - firstGlobalIdx;
+            auto bucket = bucketOf[local];
+            attach(local, bucket);
+        }
+    }
+
+    long long smallestInOverflow() const
+    {
+        if (!overflowMinValid)
+        {
+            overflowMin = NONE;
+            for (auto v : slots[nSlots])
+            {
+                overflowMin = std::min(overflowMin, bucketOf[v - firstGlobalIdx]);
+            }
+            overflowMinValid = true;
+        }
+        return overflowMin;
+    }
+
+public:
+    BucketQueue(size_t firstGlobalIdx_, size_t nLocal, size_t nSlots_)
+        : firstGlobalIdx(firstGlobalIdx_),
+          nSlots(nSlots_),
+          bucketOf(nLocal, NONE),
+          slotOf(nLocal, 0),
+          posOf(nLocal, 0),
+          slots(nSlots_ + 1),
+          base(0),
+          cursor(0),
+          nQueued(0),
+          overflowMin(NONE),
+          overflowMinValid(true)
+    {
+        if (nSlots == 0)
+        {
+            throw InvalidBucket("Bucket ring needs at least one slot");
+        }
+    }
+
+    /// @returns bucket of the vertex, or `NONE` if it is not queued
+    long long bucketOfVertex(size_t vGlobalIdx) const
+    {
+        return bucketOf[localIdx(vGlobalIdx)];
+    }
+
+    /// @brief Put the vertex into `bucket`, removing it from its previous bucket if it had one. O(1) amortized.
+    void moveTo(size_t vGlobalIdx, long long bucket)
+    {
+        auto local = localIdx(vGlobalIdx);
+        if (bucketOf[local] == bucket)
+        {
+            return;
+        }
+        if (bucketOf[local] != NONE)
+        {
+            detach(local);
+        }
+        attach(local, bucket);
+    }
+
+    void remove(size_t vGlobalIdx)
+    {
+        auto local = localIdx(vGlobalIdx);
+        if (bucketOf[local] != NONE)
+        {
+            detach(local);
+        }
+    }
+
+    /// @returns smallest non-empty bucket, or `NONE` if nothing is queued. The returned bucket is always in the ring.
+    long long minBucket()
+    {
+        if (nQueued == 0)
+        {
+            return NONE;
+        }
+        for (auto b = std::max(cursor, base); inRing(b); ++b)
+        {
+            if (!slots[b % nSlots].empty())
+            {
+                cursor = b;
+                return b;
+            }
+        }
+
+        // ring is drained: restart it at the smallest bucket waiting in the overflow
+        auto smallest = smallestInOverflow();
+        std::vector<size_t> waiting;
+        waiting.swap(slots[nSlots]);
+        base = smallest;
+        cursor = smallest;
+        nQueued -= waiting.size();
+        overflowMin = NONE;
+        overflowMinValid = true;
+        for (auto v : waiting)
+        {
+            auto local = v - firstGlobalIdx;
+            attach(local, bucketOf[local]);
+        }
+        return smallest;
+    }
+
+    /// @returns smallest non-empty bucket greater than `bucket`, or `NONE`. Does not move the ring.
+    long long minBucketAfter(long long bucket) const
+    {
+        for (auto b = std::max({cursor, base, bucket + 1}); inRing(b); ++b)
+        {
+            if (!slots[b % nSlots].empty())
+            {
+                return b;
+            }
+        }
+        // overflow buckets lie past the ring; scan them only if `bucket` itself reaches into the overflow range
+        auto smallest = smallestInOverflow();
+        if (smallest > bucket)
+        {
+            return smallest;
+        }
+        smallest = NONE;
+        for (auto v : slots[nSlots])
+        {
+            auto b = bucketOf[v - firstGlobalIdx];
+            if (b > bucket)
+            {
+                smallest = std::min(smallest, b);
+            }
+        }
+        return smallest;
+    }
+
+    /// @brief Call `fn(vGlobalIdx, bucket)` for every queued vertex, in no particular order
+    template <typename Fn>
+    void forEachQueued(Fn &&fn) const
+    {
+        for (const auto &slot : slots)
+        {
+            for (auto v : slot)
+            {
+                fn(v, bucketOf[v - firstGlobalIdx]);
+            }
+        }
+    }
+
+    /// @returns copy of the vertices in `bucket`
+    std::vector<size_t> vertices(long long bucket) const
+    {
+        if (bucket < base)
+        {
+            // nothing is ever queued below the ring
+            return {};
+        }
+        if (inRing(bucket))
+        {
+            return slots[bucket % nSlots];
+        }
+        std::vector<size_t> result;
+        for (auto v : slots[nSlots])
+        {
+            if (bucketOf[v - firstGlobalIdx] == bucket)
+            {
+                result.push_back(v);
+            }
+        }
+        return result;
+    }
+
+    size_t size(long long bucket) const
+    {
+        if (inRing(bucket))
+        {
+            return slots[bucket % nSlots].size();
+        }
+        return vertices(bucket).size();
+    }
+
+    /// @brief Remove all vertices of `bucket` from the queue
+    void clear(long long bucket)
+    {
+        for (auto v : vertices(bucket))
+        {
+            detach(v - firstGlobalIdx);
+        }
+    }
+
+    /// @brief Move every queued vertex into `bucket`
+    void mergeAllInto(long long bucket)
+    {
+        for (auto &slot : slots)
+        {
+            for (auto v : slot)
+            {
+                bucketOf[v - firstGlobalIdx] = bucket;
+            }
+        }
+        rebase(bucket);
+    }
+
+    /// @brief Move every queued vertex into bucket `bucketFor(vGlobalIdx)`, e.g. to undo `mergeAllInto`
+    template <typename Fn>
+    void requeueAll(Fn &&bucketFor)
+    {
+        auto smallest = NONE;
+        for (auto &slot : slots)
+        {
+            for (auto v : slot)
+            {
+                auto bucket = bucketFor(v);
+                if (bucket < 0 || bucket == NONE)
+                {
+                    throw InvalidBucket("Invalid bucket index: " + std::to_string(bucket));
+                }
+                bucketOf[v - firstGlobalIdx] = bucket;
+                smallest = std::min(smallest, bucket);
+            }
+        }
+        if (smallest != NONE)
+        {
+            rebase(smallest);
+        }
+    }
+
+    size_t totalQueued() const
+    {
+        return nQueued;
+    }
+};
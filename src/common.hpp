@@ -1 +1,15 @@
 #pragma once
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/// @returns index of the calling OpenMP thread; 0 outside parallel regions or when built without OpenMP
+inline int currentThread()
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
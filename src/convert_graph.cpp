@@ -0,0 +1,76 @@
+// One-time converter from the per-rank text input (`N first last` + `u v w` lines) to the binary format of
+// `BinaryGraphHeader`, which `sssp` loads directly. Multi-edges are removed and edges sorted once, here.
+//
+// Usage: ./convert_graph <input.in> <output.bin> [nProcessors] [--assume-nomultiedge]
+// With nProcessors, targets are stored resolved to (owner, index) for a block distribution over that many
+// processes; the file can then only be loaded by a run with exactly that many.
+
+#include <iostream>
+#include <string>
+#include <mpi.h>
+
+#include "block_dist.hpp"
+#include "parse_data.hpp"
+
+int main(int argc, char *argv[])
+{
+    MPI_Init(&argc, &argv);
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <input.in> <output.bin> [nProcessors] [--assume-nomultiedge]" << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+    std::string input_filename = argv[1];
+    std::string output_filename = argv[2];
+    size_t nProcessors = 0;
+    bool assume_nomultiedge = false;
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--assume-nomultiedge")
+        {
+            assume_nomultiedge = true;
+        }
+        else
+        {
+            try
+            {
+                nProcessors = std::stoull(arg);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Invalid argument: " << arg << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+        }
+    }
+
+    int result = 1;
+    {
+        auto dataOpt = process_input_and_load_graph_from_stream(0, input_filename, assume_nomultiedge);
+        if (dataOpt.has_value())
+        {
+            auto &data = *dataOpt;
+            try
+            {
+                if (nProcessors > 0 && !data.hasResolvedTargets())
+                    data.resolveTargets(BlockDistribution::Distribution(nProcessors, data.getNVerticesGlobal()));
+                if (save_graph_binary(data, output_filename, nProcessors))
+                {
+                    std::cout << output_filename << ": " << data.getNResponsible() << " vertices, " << data.getNLocalEdges()
+                              << " edge entries" << (data.hasResolvedTargets() ? ", targets resolved" : "") << std::endl;
+                    result = 0;
+                }
+            }
+            catch (std::exception &ex)
+            {
+                std::cerr << "Conversion failed: " << ex.what() << std::endl;
+            }
+            data.freeWindow();
+        }
+    }
+    MPI_Finalize();
+    return result;
+}
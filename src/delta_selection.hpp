@@ -0,0 +1,154 @@
+#pragma once
+
+#include <mpi.h>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+
+#include "logger.hpp"
+
+/// @brief Edge statistics of the loaded graph; every undirected edge counts once per stored end.
+/// Doubles throughout, so one contiguous type and one custom operation reduce them.
+struct GraphStats
+{
+    /// @brief edge entries (summed)
+    double nEdges;
+    /// @brief sum of `log(weight + 1)` over them (summed)
+    double logWeightSum;
+    double maxWeight;
+    double maxDegree;
+};
+
+struct DeltaChoice
+{
+    long long delta;
+    std::string reason;
+};
+
+/// @brief Combine the statistics of all processes with a single Allreduce.
+inline GraphStats reduceGraphStats(const GraphStats &local)
+{
+    static_assert(sizeof(GraphStats) == 4 * sizeof(double), "GraphStats must be four packed doubles");
+    MPI_Datatype type;
+    MPI_Op op;
+    MPI_CALL(MPI_Type_contiguous(4, MPI_DOUBLE, &type));
+    MPI_CALL(MPI_Type_commit(&type));
+    MPI_CALL(MPI_Op_create(
+        [](void *in, void *inout, int *len, MPI_Datatype *)
+        {
+            auto *a = static_cast<const GraphStats *>(in);
+            auto *b = static_cast<GraphStats *>(inout);
+            for (int i = 0; i < *len; ++i)
+            {
+                b[i].nEdges += a[i].nEdges;
+                b[i].logWeightSum += a[i].logWeightSum;
+                b[i].maxWeight = std::max(b[i].maxWeight, a[i].maxWeight);
+                b[i].maxDegree = std::max(b[i].maxDegree, a[i].maxDegree);
+            }
+        },
+        1, &op));
+    GraphStats global{0, 0, 0, 0};
+    MPI_CALL(MPI_Allreduce(&local, &global, 1, type, op, MPI_COMM_WORLD));
+    MPI_Op_free(&op);
+    MPI_Type_free(&type);
+    return global;
+}
+
+/// @brief `--delta auto`: `e` times the geometric mean of `weight + 1`, over the average degree.
+/// For uniform weights in `[0, W]` the numerator is about `W + 1`, so this is the classic `W / d` (8 for Graph500
+/// RMAT, where a hand sweep picked 10): a bucket holds roughly one light edge per vertex. Unlike the maximum or the
+/// arithmetic mean, a few huge edges (the one closing a big cycle) barely move a geometric mean.
+inline DeltaChoice chooseDelta(const GraphStats &global, size_t nVerticesGlobal, long long fallback)
+{
+    if (global.nEdges == 0 || nVerticesGlobal == 0)
+    {
+        return {fallback, "no edges, default " + std::to_string(fallback)};
+    }
+    auto typicalWeight = std::exp(1.0 + global.logWeightSum / global.nEdges);
+    auto avgDegree = global.nEdges / nVerticesGlobal;
+    // wider than the heaviest edge makes no difference (every edge is light); 2^62 keeps the cast defined
+    auto widest = std::min(global.maxWeight + 1, std::ldexp(1.0, 62));
+    auto delta = std::clamp(std::round(typicalWeight / avgDegree), 1.0, widest);
+    std::ostringstream reason;
+    reason << "e x geometric mean of weight+1 " << typicalWeight << " / average degree " << avgDegree
+           << " (max weight " << global.maxWeight << ", max degree " << global.maxDegree << ")";
+    return {static_cast<long long>(delta), reason.str()};
+}
+
+/// @brief `--adaptive-delta`: halves or doubles the bucket width between epochs.
+/// A bucket whose light phases ran only a few times while every vertex was relaxed about once is too thin: the
+/// epoch paid its collectives for little work, so delta doubles. A bucket where vertices were relaxed again and
+/// again (improved within the bucket after being relaxed) is too wide, so delta halves and the width it left
+/// becomes a ceiling later widening stays below. Inputs are global, so all processes agree.
+class DeltaAdaptation
+{
+public:
+    /// @brief light phases per bucket at or below which it counts as thin
+    static constexpr double THIN_PHASES = 2;
+    /// @brief relaxations of a vertex per settled vertex: below `TIGHT` nothing is wasted, above `WASTEFUL` too much
+    static constexpr double TIGHT = 1.1;
+    static constexpr double WASTEFUL = 1.5;
+    static constexpr long long MAX_DELTA = 1LL << 40;
+
+private:
+    long long delta;
+    long long ceiling = MAX_DELTA;
+    unsigned long long nChanges = 0;
+    long long minDelta;
+    long long maxDelta;
+
+public:
+    explicit DeltaAdaptation(long long delta_) : delta(delta_), minDelta(delta_), maxDelta(delta_) {}
+
+    /// @param lightPhases phases over the bucket before its long phase (all phases without IOS)
+    /// @param activations active vertices summed over those phases and processes
+    /// @param settled vertices the bucket settled
+    /// @returns width for the next epoch
+    long long next(double lightPhases, double activations, double settled)
+    {
+        if (settled <= 0)
+        {
+            return delta;
+        }
+        auto reRelaxation = activations / settled;
+        auto updated = delta;
+        if (reRelaxation > WASTEFUL && delta > 1)
+        {
+            ceiling = delta;
+            updated = delta / 2;
+        }
+        else if (lightPhases <= THIN_PHASES && reRelaxation <= TIGHT && delta * 2 < ceiling)
+        {
+            updated = delta * 2;
+        }
+        if (updated != delta)
+        {
+            nChanges++;
+            minDelta = std::min(minDelta, updated);
+            maxDelta = std::max(maxDelta, updated);
+            delta = updated;
+        }
+        return delta;
+    }
+
+    long long getDelta() const
+    {
+        return delta;
+    }
+
+    unsigned long long getNChanges() const
+    {
+        return nChanges;
+    }
+
+    long long getMinDelta() const
+    {
+        return minDelta;
+    }
+
+    long long getMaxDelta() const
+    {
+        return maxDelta;
+    }
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <limits>
+
+/// @brief Fixed-size, direct-mapped table of the best distance this process knows for remote vertices.
+/// A slot holds `{key, dist}`; `dist` is always an upper bound on the distance the owner of `key` has stored,
+/// so a relaxation with candidate `>= dist` cannot improve the target and need not be sent.
+/// Collisions simply overwrite the slot: losing an entry only costs a redundant message, never correctness.
+class GhostCache
+{
+public:
+    static constexpr uint64_t EMPTY_KEY = std::numeric_limits<uint64_t>::max();
+
+    struct Entry
+    {
+        uint64_t key;
+        long long dist;
+    };
+
+private:
+    std::vector<Entry> slots;
+    /// @brief `64 - log2(capacity)`: the slot index is the top `log2(capacity)` bits of the hash
+    unsigned shift;
+    unsigned long long nLookups;
+    unsigned long long nHits;
+
+    size_t slotOf(uint64_t key) const
+    {
+        // Fibonacci hashing: multiply by 2^64 / phi and keep the high bits, so keys of neighbouring vertices land far apart
+        return static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> shift);
+    }
+
+public:
+    GhostCache() : slots(), shift(64), nLookups(0), nHits(0) {}
+
+    /// @brief Size the table to fit in `budgetBytes`, rounded down to a power of two number of slots.
+    /// A budget of fewer than two slots disables the cache.
+    void resize(size_t budgetBytes)
+    {
+        size_t capacity = 2;
+        shift = 63;
+        while (capacity * 2 * sizeof(Entry) <= budgetBytes)
+        {
+            capacity *= 2;
+            shift--;
+        }
+        if (budgetBytes < 2 * sizeof(Entry))
+        {
+            capacity = 0;
+            shift = 64;
+        }
+        slots.assign(capacity, Entry{EMPTY_KEY, 0});
+    }
+
+    bool enabled() const
+    {
+        return !slots.empty();
+    }
+
+    /// @brief Record that `dist` is about to be sent for `key`.
+    /// @returns false if the cached distance already makes the relaxation useless
+    bool admit(uint64_t key, long long dist)
+    {
+        nLookups++;
+        auto &slot = slots[slotOf(key)];
+        if (slot.key == key)
+        {
+            if (dist >= slot.dist)
+            {
+                nHits++;
+                return false;
+            }
+            slot.dist = dist;
+            return true;
+        }
+        slot.key = key;
+        slot.dist = dist;
+        return true;
+    }
+
+    std::vector<Entry> &entries()
+    {
+        return slots;
+    }
+
+    unsigned long long getNLookups() const
+    {
+        return nLookups;
+    }
+
+    unsigned long long getNHits() const
+    {
+        return nHits;
+    }
+
+    size_t sizeBytes() const
+    {
+        return slots.size() * sizeof(Entry);
+    }
+};
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+
+/// @brief Global statistics of one delta-stepping epoch (summed over processes, so identical everywhere)
+struct EpochStats
+{
+    double phases;
+    double settled;
+    double relaxations;
+};
+
+/// @brief Global frontier sizes around one Bellman-Ford phase
+struct BellmanFordPhaseStats
+{
+    double activeBefore;
+    double activeAfter;
+    /// @brief vertices reached but not settled (everything delta-stepping would have to bucket again)
+    double queued;
+};
+
+struct HybridDecision
+{
+    bool switchNow;
+    std::string reason;
+};
+
+/// @brief Cost model choosing between delta-stepping and Bellman-Ford for the rest of the run.
+/// Cost is counted work, not time, so a run takes the same decisions every time: a relaxation costs 1 on the
+/// process doing it (the global count is split over the processes) and a phase costs `phaseCost` per doubling of
+/// the process count, as its fences and reductions take `log2(processes)` steps; a single process never pays for
+/// synchronisation.
+/// With `queued` vertices reached but not settled, delta-stepping needs `queued / settled-per-epoch` more epochs
+/// of the recent phases and relaxations per settled vertex. Bellman-Ford pipelines the remaining buckets: about
+/// one phase per remaining bucket plus one bucket's worth of light-edge hops, relaxing every edge of the queued
+/// vertices `BF_RERELAX` times. Once running, Bellman-Ford is projected from how fast its frontier shrinks.
+/// Every input is a global value, so all processes take the same decisions.
+class HybridizationModel
+{
+public:
+    /// @brief delta-stepping epochs observed at the start and after switching back before the next decision
+    static constexpr int WARMUP = 2;
+    /// @brief times Bellman-Ford is assumed to relax each remaining edge
+    static constexpr double BF_RERELAX = 2.0;
+    /// @brief Bellman-Ford is abandoned when projected this many times costlier than delta-stepping
+    /// for `PATIENCE` phases in a row
+    static constexpr double HYSTERESIS = 1.5;
+    static constexpr int PATIENCE = 2;
+    /// @brief weight of the newest epoch in the moving averages
+    static constexpr double SMOOTHING = 0.5;
+
+private:
+    struct Projection
+    {
+        double phases;
+        double relaxations;
+        double cost;
+    };
+
+    double avgDegree;
+    double nProcesses;
+    double phaseCost;
+    double phasesPerEpoch = 0;
+    double settledPerEpoch = 0;
+    double relaxationsPerSettled = 0;
+    int observed = 0;
+    int epochsSinceSwitch = 0;
+    int costlierPhases = 0;
+
+    double smooth(double average, double sample) const
+    {
+        return observed == 0 ? sample : SMOOTHING * sample + (1 - SMOOTHING) * average;
+    }
+
+    Projection project(double phases, double relaxations) const
+    {
+        return {phases, relaxations, phases * phaseCost + relaxations / nProcesses};
+    }
+
+    double epochsLeft(double queued) const
+    {
+        return queued / settledPerEpoch;
+    }
+
+    Projection deltaStepping(double queued) const
+    {
+        return project(epochsLeft(queued) * phasesPerEpoch, queued * relaxationsPerSettled);
+    }
+
+    static std::string describe(const char *name, const Projection &p)
+    {
+        std::ostringstream text;
+        text << name << " cost " << static_cast<long long>(p.cost) << " (" << static_cast<long long>(p.phases) << " phases, "
+             << static_cast<long long>(p.relaxations) << " relaxations)";
+        return text.str();
+    }
+
+public:
+    /// @brief relaxations per process a phase is worth unless configured
+    static constexpr double DEFAULT_PHASE_COST = 4096;
+
+    /// @param avgDegree_ edge entries per vertex of the whole graph
+    /// @param nProcesses_ processes the relaxations are split over
+    /// @param phaseCost_ relaxations per process one synchronisation step of a phase is worth
+    HybridizationModel(double avgDegree_, double nProcesses_, double phaseCost_)
+        : avgDegree(avgDegree_), nProcesses(std::max(1.0, nProcesses_)), phaseCost(phaseCost_ * std::log2(nProcesses))
+    {
+    }
+
+    void recordEpoch(const EpochStats &epoch)
+    {
+        if (epoch.phases <= 0 || epoch.settled <= 0)
+        {
+            return;
+        }
+        phasesPerEpoch = smooth(phasesPerEpoch, epoch.phases);
+        settledPerEpoch = smooth(settledPerEpoch, epoch.settled);
+        relaxationsPerSettled = smooth(relaxationsPerSettled, epoch.relaxations / epoch.settled);
+        observed++;
+        epochsSinceSwitch++;
+    }
+
+    /// @brief Called after every delta-stepping epoch
+    /// @param queued vertices reached but not settled, over all processes
+    HybridDecision shouldSwitchToBellmanFord(double queued) const
+    {
+        if (epochsSinceSwitch < WARMUP || queued <= 0)
+        {
+            return {false, ""};
+        }
+        auto ds = deltaStepping(queued);
+        auto bf = project(epochsLeft(queued) + phasesPerEpoch, queued * avgDegree * BF_RERELAX);
+        if (bf.cost >= ds.cost)
+        {
+            return {false, ""};
+        }
+        std::ostringstream reason;
+        reason << describe("projected Bellman-Ford", bf) << " < " << describe("delta-stepping", ds) << " for "
+               << static_cast<long long>(queued) << " queued vertices";
+        return {true, reason.str()};
+    }
+
+    /// @brief Called after every Bellman-Ford phase. A frontier shrinking by `g` per phase is done in about
+    /// `log(frontier) / log(1 / g)` phases; one that does not shrink is assumed to need a phase per remaining bucket.
+    HybridDecision shouldSwitchBack(const BellmanFordPhaseStats &phase)
+    {
+        if (observed == 0 || phase.activeBefore <= 0 || phase.activeAfter <= 0)
+        {
+            costlierPhases = 0;
+            return {false, ""};
+        }
+        auto shrink = phase.activeAfter / phase.activeBefore;
+        auto frontierEdges = phase.activeAfter * avgDegree;
+        Projection bf;
+        if (shrink < 1)
+        {
+            auto phasesLeft = std::max(1.0, std::ceil(std::log(phase.activeAfter) / -std::log(shrink)));
+            bf = project(phasesLeft, frontierEdges * (1 - std::pow(shrink, phasesLeft)) / (1 - shrink));
+        }
+        else
+        {
+            auto phasesLeft = std::max(1.0, epochsLeft(phase.queued));
+            bf = project(phasesLeft, frontierEdges * phasesLeft);
+        }
+        auto ds = deltaStepping(phase.queued);
+        costlierPhases = bf.cost > HYSTERESIS * ds.cost ? costlierPhases + 1 : 0;
+        if (costlierPhases < PATIENCE)
+        {
+            return {false, ""};
+        }
+        std::ostringstream reason;
+        reason << describe("projected Bellman-Ford", bf) << " > " << describe("delta-stepping", ds) << " for a frontier of "
+               << static_cast<long long>(phase.activeAfter) << " (" << shrink << "x per phase)";
+        return {true, reason.str()};
+    }
+
+    /// @brief Restart the warm-up and patience counts after switching in either direction
+    void switched()
+    {
+        epochsSinceSwitch = 0;
+        costlierPhases = 0;
+    }
+};
@@ -3,14 +3,22 @@
 #include <algorithm>
 #include <limits>
 #include <mpi.h>
-#include <map>
 #include <fstream>
 #include <stdexcept>
 #include <string>
+#include <optional>
+#include <sys/resource.h>
 
 #include "block_dist.hpp"
 #include "parse_data.hpp"
 #include "logger.hpp"
+#include "buckets.hpp"
+#include "phase_control.hpp"
+#include "result_writer.hpp"
+#include "hybridization.hpp"
+#include "delta_selection.hpp"
+#include "async_relax.hpp"
+#include "relax_kernels.hpp"
 
 enum class LoggingLevel
 {
@@ -19,9 +27,28 @@ enum class LoggingLevel
     Debug
 };
 
+/// @brief Which SSSP algorithm runs on the loaded `Data`.
+/// `Delta`: bucketed delta-stepping (`delta_stepping_algorithm`).
+/// `Rho` / `Radius`: label-correcting steps over a frontier of improved vertices (`frontier_stepping_algorithm`),
+/// whose threshold is the rho-th smallest tentative distance (rho-stepping) or the smallest distance plus radius
+/// (radius-stepping) instead of a fixed bucket width.
+/// `Async`: label-correcting delta-stepping without phases, exchanging relaxations point-to-point
+/// (`async_relaxation_algorithm`).
+enum class Engine
+{
+    Delta,
+    Rho,
+    Radius,
+    Async
+};
+
 const long long DEFAULT_DELTA = 10;
+const size_t DEFAULT_RHO = 1 << 16;
+const long long DEFAULT_ASYNC_WINDOW = 2;
+const size_t DEFAULT_ASYNC_BATCH = 4096;
+const long long DEFAULT_HYBRID_PHASE_COST = static_cast<long long>(HybridizationModel::DEFAULT_PHASE_COST);
 const int DEFAULT_PROGESS_FREQ = 10;
-const float HYBRIDIZATION_THRESHOLD = 0.4;
+const size_t BUCKET_RING_SLOTS = 1024;
 LoggingLevel logging_level = LoggingLevel::Progress;
 int myRank, nProcessorsGlobal;
 unsigned long long int totalPhases = 0;
@@ -29,7 +56,31 @@ unsigned long long int relaxationsBypassed = 0;
 unsigned long long int relaxationsShort = 0;
 unsigned long long int relaxationsLong = 0;
 unsigned long long int phasesBeforeBellman = 0;
+/// @brief Every switch between delta-stepping and Bellman-Ford, with where and why (identical on all processes)
+std::vector<std::string> hybridSwitches;
+/// @brief Pruning: long phases considered and run as pull, push relaxations they replaced, requests and answers sent
+unsigned long long int longPhasesConsidered = 0;
+unsigned long long int longPhasesPulled = 0;
+unsigned long long int relaxationsAvoided = 0;
+unsigned long long int pullRequests = 0;
+unsigned long long int pullResponses = 0;
+/// @brief Edges of local vertices still at distance `INF`; a pull long phase would ask over all of them
+unsigned long long int unreachedEdges = 0;
+/// @brief Active vertices processed by light phases (all phases without IOS); compared with the settled count
+/// it tells how often vertices were relaxed again within their bucket
+unsigned long long int vertexActivations = 0;
+/// @brief Control Allreduces issued by the algorithm (fences/exchanges are counted by `Data`)
+unsigned long long int totalCollectives = 0;
 double timeAtBarrier = 0;
+/// @brief Time spent relaxing edges, and handing finished chunks over / applying arrived ones between them
+/// (`--chunk-size`); the fences and exchanges closing each phase count to `timeAtBarrier`
+double timeRelaxing = 0;
+double timeBetweenChunks = 0;
+/// @brief Asynchronous engine: batches and relaxations sent to other processes, and time spent with no vertex
+/// to relax in the window (waiting for batches or for the window to move)
+unsigned long long int asyncBatchesSent = 0;
+unsigned long long int asyncRelaxationsSent = 0;
+double asyncIdleTime = 0;
 
 class VertexOwnershipException : public std::runtime_error
 {
@@ -70,6 +121,7 @@ bool anyoneHasWork(const std::vector<size_t> &activeSet)
 
     int global_has_work = 0;
     MPI_CALL(MPI_Allreduce(&local_has_work, &global_has_work, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD));
+    totalCollectives++;
     if (global_has_work)
     {
         return true;
@@ -80,19 +132,13 @@ bool anyoneHasWork(const std::vector<size_t> &activeSet)
     }
 }
 
-std::vector<size_t> getActiveSet(const std::map<long long, std::vector<size_t>> &buckets, size_t bucketIdx)
+std::vector<size_t> getActiveSet(const BucketQueue &buckets, long long bucketIdx)
 {
-    std::vector<size_t> active;
-    auto it = buckets.find(bucketIdx);
-    if (it != buckets.end())
-    {
-        active = it->second;
-    }
-    return active;
+    return buckets.vertices(bucketIdx);
 }
 
 void updateBucketInfo(
-    std::map<long long, std::vector<size_t>> &buckets,
+    BucketQueue &buckets,
     size_t vGlobalIdx,
     long long oldBucket,
     long long newBucket)
@@ -102,57 +148,32 @@ void updateBucketInfo(
         return;
     }
 
-    auto newIt = buckets.find(newBucket);
-    if (newIt != buckets.end())
+    auto tracked = buckets.bucketOfVertex(vGlobalIdx);
+    if (tracked == newBucket)
     {
-        const auto &newVec = newIt->second;
-        if (std::find(newVec.begin(), newVec.end(), vGlobalIdx) != newVec.end())
-        {
-            throw Fatal("Vertex already present in new bucket!");
-        }
+        throw Fatal("Vertex already present in new bucket!");
     }
-
-    if (oldBucket != INF)
+    if (oldBucket != INF && tracked != oldBucket)
     {
-        auto oldIt = buckets.find(oldBucket);
-        if (oldIt == buckets.end())
-        {
-            throw Fatal("Old bucket not found!");
-        }
-        auto &oldVec = oldIt->second;
-
-        auto pos = std::find(oldVec.begin(), oldVec.end(), vGlobalIdx);
-        if (pos == oldVec.end())
-        {
-            throw Fatal("Vertex not found in old bucket!");
-        }
-        oldVec.erase(pos);
+        throw Fatal("Vertex not found in old bucket!");
     }
 
-    buckets[newBucket].push_back(vGlobalIdx);
+    buckets.moveTo(vGlobalIdx, newBucket);
 }
 
-void setActiveSet(
-    std::map<long long, std::vector<size_t>> &buckets,
-    size_t bucketIdx,
-    const std::vector<size_t> &activeSet)
+/// @brief An owned vertex got its first finite distance: its edges no longer count to `unreachedEdges`
+void markReached(const Data &data, size_t vGlobalIdx)
 {
-    if (activeSet.empty())
-    {
-        buckets.erase(bucketIdx);
-    }
-    else
-    {
-        buckets[bucketIdx] = activeSet;
-    }
+    auto [first, last] = data.edgeRange(vGlobalIdx);
+    unreachedEdges -= last - first;
 }
 
+template <EdgeSubset subset>
 void relaxAllEdgesLocalBypass(
     std::vector<size_t> activeSet, // by copy!
-    const std::function<bool(size_t, size_t, long long)> &edgeConsidered,
+    long long currentK,
     Data &data,
-    const BlockDistribution::Distribution &dist,
-    std::map<long long, std::vector<size_t>> &buckets,
+    BucketQueue &buckets,
     long long delta_val
 )
 {
@@ -163,7 +184,6 @@ void relaxAllEdgesLocalBypass(
     // my optimization: if a process owns newly activated vertices, proceed
     while (!activeSet.empty())
     {
-        auto currentBucket = activeSet[0] / delta_val;
         newActive.clear();
 
         for (auto u_global_id : activeSet)
@@ -177,44 +197,41 @@ void relaxAllEdgesLocalBypass(
                 throw Fatal("We should have never entered the INF bucket!");
             }
 
-            data.forEachNeighbor(u_global_id, [&](size_t vGlobalIdx, long long w)
+            auto [first, last] = selectEdges<subset>(data, u_global_id, u_dist, currentK, delta_val,
+                                                     relaxationsShort, relaxationsLong);
+            data.forEachNeighborInRange(first, last, [&](VertexRef v, long long w)
             {
-                auto potential_new_dist = u_dist + w;
-
-                if (!edgeConsidered(u_global_id, vGlobalIdx, w)) {
-                    DEBUGN("Skipping relaxation of", u_global_id, vGlobalIdx, "as is not relevant");
+                if (w >= INF - u_dist)
+                {
                     return;
                 }
+                auto potential_new_dist = u_dist + w;
 
-                auto ownerProcessOpt = dist.getResponsibleProcessor(vGlobalIdx);
-                if (!ownerProcessOpt.has_value()) { throw Fatal("Owner doesn't exist!"); }
-                size_t ownerProcess = *ownerProcessOpt;
-
-                auto indexAtOwnerOpt = dist.globalToLocal(vGlobalIdx);
-                if (!indexAtOwnerOpt.has_value()) { throw Fatal("Owner doesn't exist!"); }
-                MPI_Aint indexAtOwner = static_cast<MPI_Aint>(*indexAtOwnerOpt);
-
-                DEBUGN("Sending update to process: ", ownerProcess, "(displacement:",
-                    indexAtOwner, "). New dist of", vGlobalIdx, "=", potential_new_dist);
+                DEBUGN("Sending update to process: ", v.owner(), "(displacement:",
+                    v.indexAtOwner(), "). New dist =", potential_new_dist);
 
                 // NOTE: this will bypass syncing window to dist afterwards!
-                if (ownerProcess == myRank) {
+                if (v.owner() == myRank) {
+                    auto vGlobalIdx = data.getFirstResponsibleGlobalIdx() + v.indexAtOwner();
                     auto prevDist = data.getDist(vGlobalIdx);
                     auto oldBucket = prevDist == INF ? INF : prevDist / delta_val;
                     auto newBucket = potential_new_dist / delta_val;
-                    DEBUGN("Try short:", vGlobalIdx, prevDist, oldBucket, newBucket, currentBucket, delta_val);
-                    if (oldBucket > currentBucket && newBucket == currentBucket) {
+                    DEBUGN("Try short:", vGlobalIdx, prevDist, oldBucket, newBucket, currentK, delta_val);
+                    if (oldBucket > currentK && newBucket == currentK) {
                         DEBUGN("Shortcut!", vGlobalIdx);
                         relaxationsBypassed++;
+                        if (prevDist == INF) {
+                            markReached(data, vGlobalIdx);
+                        }
                         data.updateDist(vGlobalIdx, potential_new_dist);
                         updateBucketInfo(buckets, vGlobalIdx, oldBucket, newBucket);
                         newActive.push_back(vGlobalIdx);
                     } else {
                         data.selfRelax(potential_new_dist, vGlobalIdx);
                     }
-                    // data.communicateRelax(potential_new_dist, ownerProcess, indexAtOwner);
+                    // data.communicateRelax(potential_new_dist, v);
                 } else {
-                    data.communicateRelax(potential_new_dist, ownerProcess, indexAtOwner);
+                    data.communicateRelax(potential_new_dist, v);
                 } 
             });
         }
@@ -222,74 +239,235 @@ void relaxAllEdgesLocalBypass(
     }
 }
 
+/// @brief Relax the selected edges of every active vertex. With `data.getNThreads() > 1` the active set is split
+/// among OpenMP threads, each buffering into its own outbox. With a chunk size, the active set is relaxed a chunk at
+/// a time and each chunk's relaxations leave (`Data::flushChunk`) before the next one is computed.
+template <EdgeSubset subset>
 void relaxAllEdges(
     const std::vector<size_t> &activeSet,
-    const std::function<bool(size_t, size_t, long long)> &edgeConsidered,
+    long long currentK,
     Data &data,
-    const BlockDistribution::Distribution &dist)
+    long long delta_val)
 {
-    for (auto u_global_id : activeSet)
-    {
-        auto u_dist = data.getDist(u_global_id);
-        DEBUGN("Relaxing neighs of vertex:", u_global_id, ". Dist of it:", u_dist);
+    bool allReached = true;
+    auto chunk = data.getChunkSize() == 0 ? activeSet.size() : data.getChunkSize();
 
-        if (u_dist == INF)
+    for (size_t begin = 0; begin < activeSet.size(); begin += chunk)
+    {
+        auto end = std::min(activeSet.size(), begin + chunk);
+        double start = MPI_Wtime();
+        allReached &= relaxActiveRange<subset>(
+            data, activeSet, begin, end, currentK, delta_val, relaxationsShort, relaxationsLong,
+            [&](VertexRef v, long long potential_new_dist, int thread)
+            {
+                DEBUGN("Sending update to process: ", v.owner(), "(displacement:",
+                    v.indexAtOwner(), "). New dist =", potential_new_dist);
+                data.communicateRelax(potential_new_dist, v, thread);
+            });
+        timeRelaxing += MPI_Wtime() - start;
+        if (end < activeSet.size())
         {
-            ERROR("FATAL");
-            throw Fatal("We should have never entered the INF bucket!");
+            start = MPI_Wtime();
+            data.flushChunk();
+            timeBetweenChunks += MPI_Wtime() - start;
         }
+    }
+
+    if (!allReached)
+    {
+        ERROR("FATAL");
+        throw Fatal("We should have never entered the INF bucket!");
+    }
+}
+
+/// @brief Long relaxations this process would push in the long phase of bucket `currentK`
+unsigned long long longPhasePushCost(const BucketQueue &buckets, long long currentK, const Data &data, long long delta_val)
+{
+    unsigned long long push = 0;
+    for (auto u : buckets.vertices(currentK))
+    {
+        push += data.edgeRange(u).second - data.firstEdgeNotLighter(u, innerShortBound(data.getDist(u), currentK, delta_val));
+    }
+    return push;
+}
 
-        data.forEachNeighbor(u_global_id, [&](size_t vGlobalIdx, long long w)
+/// @brief Requests the queued vertices past bucket `currentK` would send in a pull long phase (see
+/// `pullLongRelaxations`); unreached vertices add `unreachedEdges` on top. Counting stops past `enough`.
+unsigned long long queuedPullCost(
+    const BucketQueue &buckets, long long currentK, const Data &data, long long delta_val, unsigned long long enough)
+{
+    unsigned long long pull = 0;
+    buckets.forEachQueued([&](size_t v, long long bucket)
+    {
+        if (bucket > currentK && pull <= enough)
         {
-            auto potential_new_dist = u_dist + w;
+            pull += data.firstEdgeNotLighter(v, data.getDist(v) - currentK * delta_val) - data.edgeRange(v).first;
+        }
+    });
+    return pull;
+}
 
-            if (!edgeConsidered(u_global_id, vGlobalIdx, w)) {
-                DEBUGN("Skipping relaxation of", u_global_id, vGlobalIdx, "as is not relevant");
-                return;
-            }
+/// @brief Pruning's push-vs-pull decision for the long phase of bucket `currentK`, the same on every process.
+/// Pulling costs a request per candidate edge plus at most as many answers, so it is chosen when twice the
+/// requests are still fewer than the long relaxations pushing would send. The requests of unreached vertices
+/// are known without a scan and usually decide alone; the queued vertices are scanned only if they do not.
+bool chooseLongPhasePull(const BucketQueue &buckets, long long currentK, const Data &data, long long delta_val)
+{
+    longPhasesConsidered++;
+    unsigned long long local[2] = {longPhasePushCost(buckets, currentK, data, delta_val), unreachedEdges};
+    unsigned long long global[2] = {0, 0};
+    MPI_CALL(MPI_Allreduce(local, global, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD));
+    totalCollectives++;
+    if (2 * global[1] >= global[0])
+    {
+        return false;
+    }
 
-            auto ownerProcessOpt = dist.getResponsibleProcessor(vGlobalIdx);
-            if (!ownerProcessOpt.has_value()) { throw Fatal("Owner doesn't exist!"); }
-            size_t ownerProcess = *ownerProcessOpt;
+    // a single process over the budget already decides for push
+    auto budget = global[0] / 2 - global[1];
+    unsigned long long localQueued = queuedPullCost(buckets, currentK, data, delta_val, budget), globalQueued = 0;
+    MPI_CALL(MPI_Allreduce(&localQueued, &globalQueued, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD));
+    totalCollectives++;
+    DEBUGN("Long phase of bucket", currentK, ": push", global[0], "pull requests", global[1] + globalQueued);
+    if (2 * (global[1] + globalQueued) >= global[0])
+    {
+        return false;
+    }
+    longPhasesPulled++;
+    relaxationsAvoided += local[0];
+    return true;
+}
 
-            auto indexAtOwnerOpt = dist.globalToLocal(vGlobalIdx);
-            if (!indexAtOwnerOpt.has_value()) { throw Fatal("Owner doesn't exist!"); }
-            MPI_Aint indexAtOwner = static_cast<MPI_Aint>(*indexAtOwnerOpt);
+/// @brief Pull variant of the long phase of bucket `currentK` (pruning, IPDPS'14). Instead of the vertices of the
+/// bucket pushing their long edges, every unsettled vertex `v` asks the owners of its neighbours over edges lighter
+/// than `d(v) - currentK * delta`: only over those can a vertex settled in this bucket still improve `d(v)`.
+/// An owner answers with an ordinary relaxation if the neighbour is in the bucket and the path is shorter.
+void pullLongRelaxations(long long currentK, Data &data, long long delta_val)
+{
+    struct PullRequest
+    {
+        long long targetIdx;      // index of the asked vertex at its owner
+        long long requester;      // `VertexRef` bits of the asking vertex
+        long long weight;
+        long long requesterDist;
+    };
 
-            DEBUGN("Sending update to process: ", ownerProcess, "(displacement:",
-                indexAtOwner, "). New dist of", vGlobalIdx, "=", potential_new_dist);
+    auto answer = [&](const PullRequest &request)
+    {
+        auto uDist = data.getDist(data.getFirstResponsibleGlobalIdx() + request.targetIdx);
+        // an unreached requester asks over every edge, near-INF ones too: compare without forming the sum first
+        if (uDist != INF && uDist / delta_val == currentK && request.weight < request.requesterDist - uDist)
+        {
+            pullResponses++;
+            data.communicateRelax(uDist + request.weight, VertexRef{static_cast<uint64_t>(request.requester)});
+        }
+    };
 
-            data.communicateRelax(potential_new_dist, ownerProcess, indexAtOwner);
+    std::vector<std::vector<PullRequest>> outgoing(nProcessorsGlobal);
+    for (size_t i = 0; i < data.getNResponsible(); ++i)
+    {
+        auto v = data.getFirstResponsibleGlobalIdx() + i;
+        auto vDist = data.getDist(v);
+        if (vDist != INF && vDist / delta_val <= currentK)
+        {
+            continue;
+        }
+        auto self = VertexRef::make(myRank, i);
+        auto first = data.edgeRange(v).first;
+        auto last = data.firstEdgeNotLighter(v, vDist == INF ? INF : vDist - currentK * delta_val);
+        data.forEachNeighborInRange(first, last, [&](VertexRef u, long long w)
+        {
+            PullRequest request{static_cast<long long>(u.indexAtOwner()), static_cast<long long>(self.bits), w, vDist};
+            pullRequests++;
+            if (u.owner() == myRank)
+                answer(request);
+            else
+                outgoing[u.owner()].push_back(request);
         });
     }
+
+    // requests travel as four long longs each
+    std::vector<int> sendCounts(nProcessorsGlobal), sendDispls(nProcessorsGlobal);
+    std::vector<int> recvCounts(nProcessorsGlobal), recvDispls(nProcessorsGlobal);
+    std::vector<PullRequest> sendBuf;
+    for (int p = 0; p < nProcessorsGlobal; ++p)
+    {
+        sendDispls[p] = mpiCount(4 * sendBuf.size());
+        sendCounts[p] = mpiCount(4 * outgoing[p].size());
+        sendBuf.insert(sendBuf.end(), outgoing[p].begin(), outgoing[p].end());
+        std::vector<PullRequest>().swap(outgoing[p]);
+    }
+    MPI_CALL(MPI_Alltoall(sendCounts.data(), 1, MPI_INT, recvCounts.data(), 1, MPI_INT, MPI_COMM_WORLD));
+    size_t nRecv = 0;
+    for (int p = 0; p < nProcessorsGlobal; ++p)
+    {
+        recvDispls[p] = mpiCount(nRecv);
+        nRecv += recvCounts[p];
+    }
+    std::vector<PullRequest> recvBuf(nRecv / 4);
+    MPI_CALL(MPI_Alltoallv(sendBuf.data(), sendCounts.data(), sendDispls.data(), MPI_LONG_LONG,
+                           recvBuf.data(), recvCounts.data(), recvDispls.data(), MPI_LONG_LONG, MPI_COMM_WORLD));
+    totalCollectives += 2;
+
+    for (const auto &request : recvBuf)
+    {
+        answer(request);
+    }
+}
+
+/// @brief What this process reports after a phase of bucket `currentK`. The next bucket and the settled count
+/// only matter once nobody has active vertices left, so a process that still has some skips computing them.
+ControlState phaseControlState(const BucketQueue &buckets, long long currentK, const std::vector<size_t> &activeSet)
+{
+    if (!activeSet.empty())
+    {
+        return {static_cast<long long>(activeSet.size()), BucketQueue::NONE, 0};
+    }
+    auto next = buckets.minBucketAfter(currentK);
+    return {0, next == BucketQueue::NONE ? INF : next, static_cast<long long>(buckets.size(currentK))};
 }
 
-void processBucket(
-    std::map<long long, std::vector<size_t>> &buckets,
+/// @brief Run phases over bucket `currentK` from `activeSet` until no process has active vertices left in it,
+/// or until `maxPhases` phases ran; `activeSet` then holds the vertices the next phase starts from.
+/// With `control`, the work check of each phase is the fused reduction closing the previous one; the first phase
+/// always runs, as the caller only enters a bucket that is non-empty somewhere, unless the call `resumes` one
+/// that stopped at `maxPhases`.
+/// @returns whether the bucket is done everywhere
+template <EdgeSubset subset>
+bool processBucket(
+    BucketQueue &buckets,
     size_t currentK,
     Data &data,
-    const BlockDistribution::Distribution &dist,
     long long delta_val,
-    const std::function<bool(size_t, size_t, long long)> &edgeConsidered,
-    bool enable_local_bypass)
+    bool enable_local_bypass,
+    ControlReduction *control,
+    bool pull,
+    std::vector<size_t> &activeSet,
+    size_t maxPhases = std::numeric_limits<size_t>::max(),
+    bool resumes = false)
 {
     size_t phaseNo = 0;
 
-    // Determine the active set S for this process (it might be empty, that's OK)
-    std::vector<size_t> activeSet = getActiveSet(buckets, currentK);
-
     while (true)
     {
+        if (phaseNo == maxPhases)
+        {
+            return false;
+        }
         // STEP 1: All processes collectively decide if there is any work left for this 'k'.
         // If the global sum is 0, NO process has work for 'currentK'. ALL break the phase loop.
-        if (!anyoneHasWork(activeSet))
+        if (control == nullptr ? !anyoneHasWork(activeSet) : (phaseNo > 0 || resumes) && control->last().nActive == 0)
         {
             DEBUGN("Process", myRank, "no more work for k=", currentK);
-            break;
+            return true;
         }
         // We now know that at least one process has work, so ALL processes must participate in the phase.
         totalPhases++;
         phaseNo++;
+        if constexpr (subset != EdgeSubset::Long)
+        {
+            vertexActivations += activeSet.size();
+        }
 
         {
             DEBUG("Process", myRank, "starting phase", phaseNo, "for k=", currentK);
@@ -310,21 +488,23 @@ void processBucket(
             PROGRESSN("FENCE SYNC 1: waiting...");
             data.syncWindowToActual();
             double start = MPI_Wtime();
-            data.fence();
+            data.beginRelaxations();
             double end = MPI_Wtime();
             timeAtBarrier += end - start;
             DEBUGN("FENCE SYNC 1: done! Performing relaxations...");
         }
 
-        if (enable_local_bypass)
+        if (pull)
+        {
+            pullLongRelaxations(currentK, data, delta_val);
+        }
+        else if (enable_local_bypass)
         {
-            relaxAllEdgesLocalBypass(activeSet, edgeConsidered, data, dist, buckets, delta_val);
-            // relaxAllEdgesLocalBypass(activeSet, edgeConsidered, data, dist, delta_val);
-            // relaxAllEdgesLocalBypass(activeSet, edgeConsidered, data, dist);
+            relaxAllEdgesLocalBypass<subset>(activeSet, currentK, data, buckets, delta_val);
         }
         else
         {
-            relaxAllEdges(activeSet, edgeConsidered, data, dist);
+            relaxAllEdges<subset>(activeSet, currentK, data, delta_val);
         }
 
         // --- FENCE 2 ---
@@ -332,7 +512,7 @@ void processBucket(
             // data.communicateRelax(INF, myRank, 0);
             PROGRESSN("FENCE SYNC 2: waiting... epoch:", totalPhases);
             double start = MPI_Wtime();
-            data.fence();
+            data.finishRelaxations();
             double end = MPI_Wtime();
             timeAtBarrier += end - start;
             PROGRESSN("FENCE SYNC 2: done!");
@@ -353,6 +533,10 @@ void processBucket(
             auto newBucket = newDist / delta_val;
 
             updateBucketInfo(buckets, vGlobalIdx, oldBucket, newBucket);
+            if (prevDist == INF)
+            {
+                markReached(data, vGlobalIdx);
+            }
 
             if (newBucket == currentK)
             {
@@ -372,23 +556,31 @@ void processBucket(
             }
         }
         DEBUGN("]");
+
+        if (control != nullptr)
+        {
+            // the next phase (or bucket) starts from a synced window anyway; copy it while the reduction runs
+            control->reduce(phaseControlState(buckets, currentK, activeSet), [&]
+                            { data.syncWindowToActual(); });
+        }
     } // end of while(true) phase loop
 }
 
 void delta_stepping_algorithm(
     Data &data,
-    const BlockDistribution::Distribution &dist,
     size_t root_rt_global_id,
     long long delta_val,
     int progress_freq,
     bool enable_ios,
     bool enable_pruning,
     bool enable_local_bypass,
-    bool enable_hybridization)
+    bool enable_hybridization,
+    long long hybrid_phase_cost,
+    int ghost_refresh_freq,
+    ControlReduction *control,
+    DeltaAdaptation *adaptation)
 {
-    (void)enable_pruning;
-    (void)enable_hybridization;
-    std::map<long long, std::vector<size_t>> buckets;
+    BucketQueue buckets(data.getFirstResponsibleGlobalIdx(), data.getNResponsible(), BUCKET_RING_SLOTS);
 
     DEBUGN("Process", myRank, "processing", data.getNResponsible(), "vertices!");
     if (data.getNResponsible() < 1000)
@@ -397,11 +589,8 @@ void delta_stepping_algorithm(
         {
             auto owned = data.getFirstResponsibleGlobalIdx() + localVertexId;
             DEBUG("\nVertex:", owned, "neighbours: [");
-            auto curNeighs = data.getNeigh()[localVertexId];
-            for (size_t i = 0; i < curNeighs.size(); ++i)
-            {
-                DEBUG(curNeighs[i].first, "(@", curNeighs[i].second, "), ");
-            }
+            data.forEachNeighbor(owned, [](VertexRef neigh, long long w)
+                                 { DEBUG(neigh.owner(), ":", neigh.indexAtOwner(), "(@", w, "), "); });
             DEBUG("]");
         }
     }
@@ -409,44 +598,116 @@ void delta_stepping_algorithm(
 
     bool isBellmanFord = false;
     unsigned long long int settledVerticesGlobal = 0;
+    long long bucketDelta = delta_val;
+    data.splitByWeight(delta_val);
 
+    unreachedEdges = data.getNLocalEdges();
     if (data.isOwned(root_rt_global_id))
     {
+        markReached(data, root_rt_global_id);
         data.updateDist(root_rt_global_id, 0);
         updateBucketInfo(buckets, root_rt_global_id, INF, 0);
     }
 
+    auto seedControl = [&]
+    {
+        // seeds the first bucket; afterwards every bucket comes from the reduction closing the previous epoch
+        ControlState local{0, buckets.totalQueued() > 0 ? buckets.minBucket() : INF, 0};
+        control->reduce(local, [&]
+                        { data.syncWindowToActual(); });
+    };
+    if (control != nullptr)
+    {
+        seedControl();
+    }
+
+    std::optional<HybridizationModel> model;
+    if (enable_hybridization)
+    {
+        unsigned long long localEdges = data.getNLocalEdges(), globalEdges = 0;
+        MPI_CALL(MPI_Allreduce(&localEdges, &globalEdges, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD));
+        totalCollectives++;
+        model.emplace(static_cast<double>(globalEdges) / data.getNVerticesGlobal(), nProcessorsGlobal,
+                      static_cast<double>(hybrid_phase_cost));
+    }
+    auto recordSwitch = [&](size_t epoch, const std::string &what, const std::string &reason)
+    {
+        hybridSwitches.push_back("epoch " + std::to_string(epoch) + ", phase " + std::to_string(totalPhases) + ", " +
+                                 std::to_string(settledVerticesGlobal) + " settled: " + what + " (" + reason + ")");
+        PROGRESSN("Hybridization:", hybridSwitches.back());
+    };
+    // sums `values` over all processes in place
+    auto sumGlobally = [&](std::vector<double> &values)
+    {
+        MPI_CALL(MPI_Allreduce(MPI_IN_PLACE, values.data(), static_cast<int>(values.size()), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD));
+        totalCollectives++;
+    };
+
+    // Bellman-Ford runs one phase per iteration over everything queued, merged into bucket 0
+    std::vector<size_t> bellmanFordActive;
+    bool bellmanFordResumes = false;
+
     // Main loop: every iteration is one epoch
     size_t epochNo = 0;
     while (true)
     {
-        if (isBellmanFord) {
-            delta_val = INF;
+        if (isBellmanFord)
+        {
+            std::vector<double> frontier{static_cast<double>(bellmanFordActive.size()), 0, 0};
+            bool done = processBucket<EdgeSubset::All>(buckets, 0, data, delta_val, enable_local_bypass, control, false,
+                                                       bellmanFordActive, 1, bellmanFordResumes);
+            bellmanFordResumes = true;
+            if (done)
+            {
+                DEBUGN("Bellman-Ford converged. Exiting.");
+                break;
+            }
+            frontier[1] = static_cast<double>(bellmanFordActive.size());
+            frontier[2] = static_cast<double>(buckets.totalQueued());
+            sumGlobally(frontier);
+            auto decision = model->shouldSwitchBack({frontier[0], frontier[1], frontier[2]});
+            if (decision.switchNow)
+            {
+                recordSwitch(epochNo, "back to delta-stepping", decision.reason);
+                model->switched();
+                isBellmanFord = false;
+                delta_val = bucketDelta;
+                data.splitByWeight(delta_val);
+                // vertices Bellman-Ford already relaxed at their current distance are relaxed once more from their bucket
+                buckets.requeueAll([&](size_t vGlobalIdx)
+                                   { return data.getDist(vGlobalIdx) / delta_val; });
+                bellmanFordActive.clear();
+                if (control != nullptr)
+                {
+                    seedControl();
+                }
+            }
+            continue;
         }
-        
-        long long localMinK = INF;
-        for (auto it = buckets.begin(); it != buckets.end() && it->second.empty(); it = buckets.begin())
+
+        long long localMinK = buckets.minBucket();
+        long long currentK = INF;
+        if (control == nullptr)
         {
-            buckets.erase(it);
+            MPI_CALL(MPI_Allreduce(&localMinK, &currentK, 1, MPI_LONG_LONG, MPI_MIN, MPI_COMM_WORLD));
+            totalCollectives++;
         }
-        if (!buckets.empty())
+        else
         {
-            localMinK = buckets.begin()->first;
+            currentK = control->last().minBucket;
         }
-        long long currentK = INF;
-        MPI_CALL(MPI_Allreduce(&localMinK, &currentK, 1, MPI_LONG_LONG, MPI_MIN, MPI_COMM_WORLD));
 
         if (epochNo % progress_freq == 0)
         {
             PROGRESSN("Process", myRank, "is starting epoch", epochNo);
-            if (!buckets.empty())
+            if (localMinK != BucketQueue::NONE)
             {
                 if (currentK == INF)
                     PROGRESSN("Bucket considered:", "INF");
                 else
                     PROGRESSN(
                         "Bucket considered:", currentK, "(raported my best bucket:",
-                        localMinK, "of", buckets.begin()->second.size(), "nodes");
+                        localMinK, "of", buckets.size(localMinK), "nodes");
             }
             else
             {
@@ -458,83 +719,398 @@ void delta_stepping_algorithm(
         }
         epochNo++;
 
-        // this will not catch Bellman-Ford termination. it's catched at the end of loop.
         if (currentK == INF)
         {
             DEBUGN("Termination condition met. Exiting.");
             break;
         }
 
-        auto isInnerShort = [&data, delta_val, currentK](size_t uGlobalIdx, [[maybe_unused]] size_t vGlobalIdx, long long weight) -> bool
-        {
-            auto u_dist = data.getDist(uGlobalIdx);
-            auto potential_new_dist = u_dist + weight;
-            return weight < delta_val && potential_new_dist <= (currentK + 1) * delta_val - 1;
-        };
+        auto phasesBefore = totalPhases;
+        auto activationsBefore = vertexActivations;
+        auto relaxationsBefore = relaxationsShort + relaxationsLong;
 
+        auto activeSet = getActiveSet(buckets, currentK);
+        unsigned long long lightPhases = 0;
         if (!enable_ios)
         {
-            processBucket(buckets, currentK, data, dist, delta_val, [&isInnerShort](size_t uGlobalIdx, size_t vGlobalIdx, long long weight) -> bool
-                          {
-                            // here we assume the relaxation will always be made
-                            if (isInnerShort(uGlobalIdx, vGlobalIdx, weight)) {
-                                relaxationsShort++;
-                            } else {
-                                relaxationsLong++;
-                            }
-                            return true; }, enable_local_bypass);
+            processBucket<EdgeSubset::All>(buckets, currentK, data, delta_val, enable_local_bypass, control, false, activeSet);
+            lightPhases = totalPhases - phasesBefore;
         }
         else
         {
             // SHORT PHASE; this will execute many iterations of the internal loop
-            processBucket(buckets, currentK, data, dist, delta_val, [&isInnerShort](size_t uGlobalIdx, size_t vGlobalIdx, long long weight) -> bool
-                          {
-                            // here we assume the relaxation will always be made
-                            if (isInnerShort(uGlobalIdx, vGlobalIdx, weight)) {
-                                relaxationsShort++;
-                                return true;
-                            }
-                            return false; }, enable_local_bypass);
-            // LONG PHASE; this will be just a single iteration
-            processBucket(buckets, currentK, data, dist, delta_val, [&isInnerShort](size_t uGlobalIdx, size_t vGlobalIdx, long long weight) -> bool
-                          {
-                            // here we assume the relaxation will always be made
-                            if (isInnerShort(uGlobalIdx, vGlobalIdx, weight)) {
-                                return false;
-                            }
-                            relaxationsLong++;
-                            return true; }, enable_local_bypass);
-        }
-
-        if (isBellmanFord) {
-            break;
+            processBucket<EdgeSubset::InnerShort>(buckets, currentK, data, delta_val, enable_local_bypass, control, false, activeSet);
+            lightPhases = totalPhases - phasesBefore;
+            // LONG PHASE; this will be just a single iteration, pushed or (with pruning) pulled
+            bool pull = enable_pruning && chooseLongPhasePull(buckets, currentK, data, delta_val);
+            activeSet = getActiveSet(buckets, currentK);
+            processBucket<EdgeSubset::Long>(buckets, currentK, data, delta_val, enable_local_bypass, control, pull, activeSet);
+        }
+
+        if (ghost_refresh_freq > 0 && epochNo % ghost_refresh_freq == 0 && data.getGhostCache().enabled())
+        {
+            data.refreshGhosts();
         }
 
-        long long local_settled_currentK = static_cast<long long>(getActiveSet(buckets, currentK).size());
         long long global_settled_currentK;
-        MPI_CALL(MPI_Allreduce(&local_settled_currentK, &global_settled_currentK, 1, MPI_LONG_LONG_INT, MPI_SUM, MPI_COMM_WORLD));
+        if (control == nullptr)
+        {
+            long long local_settled_currentK = static_cast<long long>(buckets.size(currentK));
+            MPI_CALL(MPI_Allreduce(&local_settled_currentK, &global_settled_currentK, 1, MPI_LONG_LONG_INT, MPI_SUM, MPI_COMM_WORLD));
+            totalCollectives++;
+        }
+        else
+        {
+            global_settled_currentK = control->last().nSettled;
+        }
 
         settledVerticesGlobal += global_settled_currentK;
-        if (enable_hybridization && settledVerticesGlobal >= HYBRIDIZATION_THRESHOLD * data.getNVerticesGlobal()) {
-            phasesBeforeBellman = totalPhases;
-            isBellmanFord = true;
-            std::vector<size_t> bellmanBucket;
-            for (auto it = buckets.begin(); it != buckets.end(); it = buckets.begin())
+        buckets.clear(currentK);
+        if (!model && adaptation == nullptr)
+        {
+            continue;
+        }
+
+        // relaxations, queued vertices and activations, summed over processes
+        std::vector<double> epoch{static_cast<double>(relaxationsShort + relaxationsLong - relaxationsBefore),
+                                  static_cast<double>(buckets.totalQueued()),
+                                  static_cast<double>(vertexActivations - activationsBefore)};
+        sumGlobally(epoch);
+        if (adaptation != nullptr)
+        {
+            auto adapted = adaptation->next(static_cast<double>(lightPhases), epoch[2], static_cast<double>(global_settled_currentK));
+            if (adapted != delta_val)
+            {
+                PROGRESSN("Epoch", epochNo, ": delta", delta_val, "->", adapted);
+                delta_val = adapted;
+                bucketDelta = adapted;
+                // the queued vertices (all at distances beyond the settled bucket) move to their buckets of the new width
+                data.splitByWeight(delta_val);
+                buckets.requeueAll([&](size_t vGlobalIdx)
+                                   { return data.getDist(vGlobalIdx) / delta_val; });
+                if (control != nullptr)
+                {
+                    seedControl();
+                }
+            }
+        }
+        if (!model)
+        {
+            continue;
+        }
+        model->recordEpoch({static_cast<double>(totalPhases - phasesBefore), static_cast<double>(global_settled_currentK),
+                            epoch[0]});
+        auto decision = model->shouldSwitchToBellmanFord(epoch[1]);
+        if (decision.switchNow)
+        {
+            recordSwitch(epochNo, "to Bellman-Ford", decision.reason);
+            model->switched();
+            if (phasesBeforeBellman == 0)
             {
-                bellmanBucket.insert(bellmanBucket.end(), it->second.begin(), it->second.end());
-                buckets.erase(it);
+                phasesBeforeBellman = totalPhases;
             }
-            setActiveSet(buckets, 0, bellmanBucket);
-        } else {
-            setActiveSet(buckets, currentK, {});
+            isBellmanFord = true;
+            delta_val = INF;
+            data.splitByWeight(delta_val);
+            buckets.mergeAllInto(0);
+            bellmanFordActive = getActiveSet(buckets, 0);
+            bellmanFordResumes = false;
         }
     } // end of while(true) epoch loop
     return;
 }
 
+/// @brief The step threshold this process proposes; the global one is the maximum for rho-stepping and the
+/// minimum for radius-stepping.
+/// Rho-stepping: the `rhoPerProcess`-th smallest tentative distance in the local frontier (its largest if smaller),
+/// so a step relaxes at least `rho` frontier vertices overall.
+/// Radius-stepping: the smallest `d(v) + r(v)`, where the radius `r(v)` is the weight of the `rho`-th lightest edge
+/// of `v` (read from its weight-sorted CSR range), a cheap stand-in for the distance to its `rho`-th nearest vertex.
+long long localStepThreshold(const Data &data, const std::vector<size_t> &frontier, Engine engine, size_t rho,
+                             size_t rhoPerProcess)
+{
+    if (engine == Engine::Rho)
+    {
+        std::vector<long long> dists;
+        dists.reserve(frontier.size());
+        for (auto v : frontier)
+        {
+            dists.push_back(data.getDist(v));
+        }
+        auto kth = dists.begin() + (std::min(rhoPerProcess, dists.size()) - 1);
+        std::nth_element(dists.begin(), kth, dists.end());
+        return *kth;
+    }
+    long long threshold = INF;
+    for (auto v : frontier)
+    {
+        auto [first, last] = data.edgeRange(v);
+        auto radius = first == last ? INF : data.getAdjWeights()[first + std::min(rho, last - first) - 1];
+        auto d = data.getDist(v);
+        threshold = std::min(threshold, radius >= INF - d ? INF : d + radius);
+    }
+    return threshold;
+}
+
+/// @brief Rho-stepping and radius-stepping on the same `Data`, communication layer and phase structure as
+/// delta-stepping. Every vertex whose distance improved joins the frontier; each step agrees on a threshold in one
+/// Allreduce and relaxes all edges of the frontier vertices at or below it. Rho-stepping runs one phase per step;
+/// radius-stepping repeats phases until no frontier vertex at or below the threshold is left anywhere.
+/// The run ends when every frontier is empty.
+void frontier_stepping_algorithm(
+    Data &data,
+    size_t root_rt_global_id,
+    Engine engine,
+    size_t rho,
+    int progress_freq)
+{
+    // every edge is relaxed whole; a single infinite bucket makes the shared kernels count them all as short
+    data.splitByWeight(INF);
+    auto rhoPerProcess = std::max<size_t>(1, rho / nProcessorsGlobal);
+    std::vector<char> inFrontier(data.getNResponsible(), 0);
+    std::vector<size_t> frontier;
+    auto enqueue = [&](size_t vGlobalIdx)
+    {
+        auto &flag = inFrontier[vGlobalIdx - data.getFirstResponsibleGlobalIdx()];
+        if (!flag)
+        {
+            flag = 1;
+            frontier.push_back(vGlobalIdx);
+        }
+    };
+    // moves the frontier vertices at or below `threshold` into `active`; a vertex improved to the threshold while
+    // still in the frontier is relaxed within the step and once more from the frontier, which is harmless
+    auto extract = [&](long long threshold, std::vector<size_t> &active)
+    {
+        active.clear();
+        auto kept = std::partition(frontier.begin(), frontier.end(), [&](size_t v)
+                                   { return data.getDist(v) > threshold; });
+        for (auto it = kept; it != frontier.end(); ++it)
+        {
+            inFrontier[*it - data.getFirstResponsibleGlobalIdx()] = 0;
+            active.push_back(*it);
+        }
+        frontier.erase(kept, frontier.end());
+    };
+
+    if (data.isOwned(root_rt_global_id))
+    {
+        data.updateDist(root_rt_global_id, 0);
+        enqueue(root_rt_global_id);
+    }
+
+    std::vector<size_t> active;
+    size_t stepNo = 0;
+    while (true)
+    {
+        // [-(has work), threshold], both reduced with MIN: rho-stepping negates its threshold to get the maximum
+        long long local[2] = {frontier.empty() ? 0 : -1, INF};
+        if (!frontier.empty())
+        {
+            auto threshold = localStepThreshold(data, frontier, engine, rho, rhoPerProcess);
+            local[1] = engine == Engine::Rho ? -threshold : threshold;
+        }
+        else if (engine == Engine::Rho)
+        {
+            local[1] = 0;
+        }
+        long long global[2];
+        MPI_CALL(MPI_Allreduce(local, global, 2, MPI_LONG_LONG, MPI_MIN, MPI_COMM_WORLD));
+        totalCollectives++;
+        if (global[0] == 0)
+        {
+            DEBUGN("Every frontier is empty. Exiting.");
+            break;
+        }
+        auto threshold = engine == Engine::Rho ? -global[1] : global[1];
+        if (stepNo % progress_freq == 0)
+        {
+            PROGRESSN("Process", myRank, "is starting step", stepNo, "with threshold", threshold, "and", frontier.size(),
+                      "frontier vertices");
+        }
+        stepNo++;
+
+        extract(threshold, active);
+        for (size_t phaseNo = 0; engine == Engine::Radius || phaseNo == 0; ++phaseNo)
+        {
+            if (engine == Engine::Radius && !anyoneHasWork(active))
+            {
+                break;
+            }
+            totalPhases++;
+
+            data.syncWindowToActual();
+            double start = MPI_Wtime();
+            data.beginRelaxations();
+            timeAtBarrier += MPI_Wtime() - start;
+
+            relaxAllEdges<EdgeSubset::All>(active, 0, data, INF);
+
+            start = MPI_Wtime();
+            data.finishRelaxations();
+            timeAtBarrier += MPI_Wtime() - start;
+
+            // radius-stepping relaxes what dropped to the threshold within the step; anything else waits in the frontier
+            active.clear();
+            for (auto update : data.getUpdatesAndSyncDataToWin())
+            {
+                DEBUGN("Update registered:", update.vGlobalIdx, "changed from", update.prevDist, "to", update.newDist);
+                if (engine == Engine::Radius && update.newDist <= threshold)
+                {
+                    active.push_back(update.vGlobalIdx);
+                }
+                else
+                {
+                    enqueue(update.vGlobalIdx);
+                }
+            }
+        }
+    }
+}
+
+/// @brief Delta-stepping without phases or fences. Every process relaxes its own buckets as soon as it has them,
+/// label-correcting (a vertex improved again is simply relaxed again), but only buckets less than `window` above the
+/// smallest queued bucket of any process, so nobody runs far ahead on distances that are still going to drop.
+/// Relaxations of remote vertices travel in point-to-point batches (`RelaxBatches`), applied by their owner
+/// whenever it polls. A wave of non-blocking Allreduces runs all the time: it tells every process where the window
+/// starts, and two consecutive waves decide termination (`TerminationDetector`). Partial batches are sent at every
+/// wave and whenever the window has no work left, so no relaxation waits longer than a wave.
+void async_relaxation_algorithm(
+    Data &data,
+    size_t root_rt_global_id,
+    long long delta_val,
+    long long window,
+    size_t batchSize,
+    int progress_freq)
+{
+    // every edge is relaxed whole; a single infinite bucket makes `splitByWeight` count them all as light
+    data.splitByWeight(INF);
+    MPI_Comm comm;
+    MPI_CALL(MPI_Comm_dup(MPI_COMM_WORLD, &comm));
+    {
+        BucketQueue buckets(data.getFirstResponsibleGlobalIdx(), data.getNResponsible(), BUCKET_RING_SLOTS);
+        RelaxBatches batches(comm, nProcessorsGlobal, batchSize);
+        WaveReduction waves(comm);
+        TerminationDetector termination;
+        auto firstOwned = data.getFirstResponsibleGlobalIdx();
+
+        auto improve = [&](size_t vGlobalIdx, long long newDist)
+        {
+            if (newDist < data.getDist(vGlobalIdx))
+            {
+                data.updateDist(vGlobalIdx, newDist);
+                buckets.moveTo(vGlobalIdx, newDist / delta_val);
+            }
+        };
+        auto applyBatch = [&](const RelaxMessage &msg)
+        {
+            improve(firstOwned + msg.indexAtOwner, msg.newDist);
+        };
+
+        if (data.isOwned(root_rt_global_id))
+        {
+            improve(root_rt_global_id, 0);
+        }
+
+        // before the first wave completes only the root's bucket 0 can be queued anywhere
+        long long windowStart = 0;
+        while (true)
+        {
+            batches.poll(applyBatch);
+
+            auto k = buckets.minBucket();
+            // `windowStart` is stale: anything below it is in the window too (and `NONE` leaves everything in it)
+            if (k != BucketQueue::NONE && k - windowStart < window)
+            {
+                auto active = buckets.vertices(k);
+                buckets.clear(k);
+                vertexActivations += active.size();
+                for (auto u : active)
+                {
+                    auto u_dist = data.getDist(u);
+                    auto [first, last] = data.edgeRange(u);
+                    relaxationsShort += last - first;
+                    data.forEachNeighborInRange(first, last, [&](VertexRef v, long long w)
+                    {
+                        if (w >= INF - u_dist)
+                        {
+                            return;
+                        }
+                        if (v.owner() == myRank)
+                        {
+                            improve(firstOwned + v.indexAtOwner(), u_dist + w);
+                        }
+                        else
+                        {
+                            batches.push(v.owner(), static_cast<long long>(v.indexAtOwner()), u_dist + w);
+                        }
+                    });
+                }
+            }
+            else
+            {
+                double start = MPI_Wtime();
+                batches.flush();
+                batches.poll(applyBatch);
+                asyncIdleTime += MPI_Wtime() - start;
+            }
+
+            if (!waves.inFlight())
+            {
+                batches.flush();
+                k = buckets.minBucket();
+                waves.start({batches.getNSent(), batches.getNReceived(), k == BucketQueue::NONE ? 0 : 1, k});
+                continue;
+            }
+            auto *global = waves.test();
+            if (global == nullptr)
+            {
+                continue;
+            }
+            totalPhases++;
+            totalCollectives++;
+            if (termination.observe(*global))
+            {
+                DEBUGN("Two equal waves with everybody idle. Exiting.");
+                break;
+            }
+            windowStart = global->minBucket;
+            if (totalPhases % progress_freq == 0)
+            {
+                PROGRESSN("Process", myRank, "finished wave", totalPhases, "; window starts at bucket", windowStart, ",",
+                          global->busy, "processes busy,", global->sent - global->received, "batches in flight");
+            }
+        }
+        batches.finish();
+        asyncBatchesSent = batches.getNSent();
+        asyncRelaxationsSent = batches.getNRelaxationsSent();
+    }
+    MPI_Comm_free(&comm);
+}
+
+/// @brief This process's share of the statistics `--delta auto` is derived from
+GraphStats localGraphStats(const Data &data)
+{
+    const auto &offsets = data.getAdjOffsets();
+    const auto &weights = data.getAdjWeights();
+    GraphStats local{static_cast<double>(weights.size()), 0, 0, 0};
+    for (auto w : weights)
+    {
+        local.logWeightSum += std::log1p(static_cast<double>(w));
+        local.maxWeight = std::max(local.maxWeight, static_cast<double>(w));
+    }
+    for (size_t i = 0; i + 1 < offsets.size(); ++i)
+    {
+        local.maxDegree = std::max(local.maxDegree, static_cast<double>(offsets[i + 1] - offsets[i]));
+    }
+    return local;
+}
+
 int main(int argc, char *argv[])
 {
-    MPI_Init(&argc, &argv);
+    // relaxation threads never call MPI; only the main thread does
+    int threadSupport = MPI_THREAD_SINGLE;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &threadSupport);
     MPI_Comm_set_errhandler(MPI_COMM_WORLD, MPI_ERRORS_RETURN);
 
     // MPI_Win dist_window = MPI_WIN_NULL; // MPI Window for one-sided access to distances
@@ -551,16 +1127,62 @@ int main(int argc, char *argv[])
             std::cerr << "\nUsage:\n";
             std::cerr << "  " << argv[0] << " <input_file> <output_file> [delta > 0] [options]\n\n";
             std::cerr << "Required arguments:\n";
-            std::cerr << "  <input_file>             Path to input graph data\n";
-            std::cerr << "  <output_file>            Path where results will be written\n";
-            std::cerr << "  [delta > 0]              (Optional) Delta-stepping bucket width (default: " << DEFAULT_DELTA << ")\n\n";
+            std::cerr << "  <input_file>             Path to input graph data: text, or binary written by convert_graph;\n";
+            std::cerr << "                           with --graph500, the folder holding edges.out and edges.out.weights\n";
+            std::cerr << "  <output_file>            Path where results will be written (the same path on all ranks unless\n";
+            std::cerr << "                           --output-mode per-rank)\n";
+            std::cerr << "  [delta > 0 | auto]       (Optional) Delta-stepping bucket width, or auto to derive it from the loaded\n";
+            std::cerr << "                           graph's weights and degrees (default: " << DEFAULT_DELTA << ")\n\n";
 
             std::cerr << "Optional flags:\n";
             std::cerr << "  --ios / --noios          Enable or disable IOS optimizations (default: enabled)\n";
-            std::cerr << "  --pruning / --nopruning  Enable or disable pruning optimization (default: disabled)\n";
+            std::cerr << "  --pruning / --nopruning  Enable or disable pruning: per bucket, the long phase is pulled by unsettled\n";
+            std::cerr << "                           vertices when that needs fewer messages than pushing; needs --ios (default: disabled)\n";
             std::cerr << "  --local-bypass / --nolocal-bypass  Enable or disable dynamically adding just relaxed nodes to active set inside one processor (default: disabled)\n";
             std::cerr << "  --hybrid / --nohybrid    Enable or disable hybridization optimization (default: enabled)\n";
+            std::cerr << "  --hybrid-phase-cost <int>  Relaxations per process one phase is worth in the hybridization cost\n";
+            std::cerr << "                           model, which counts work instead of timing it (default: " << DEFAULT_HYBRID_PHASE_COST << ")\n";
+            std::cerr << "  --adaptive-delta / --noadaptive-delta  Halve or double delta between epochs from the phases per bucket\n";
+            std::cerr << "                           and how often vertices were relaxed again (default: disabled)\n";
+            std::cerr << "  --engine <name>          delta (bucketed delta-stepping) | rho (rho-stepping: each step relaxes the\n";
+            std::cerr << "                           frontier vertices up to the rho-th smallest distance) | radius (radius-stepping:\n";
+            std::cerr << "                           up to the smallest distance plus radius); the frontier engines ignore\n";
+            std::cerr << "                           delta and reject the delta-stepping optimizations (--noios, --nohybrid,\n";
+            std::cerr << "                           --hybrid-phase-cost, --pruning, --local-bypass, --adaptive-delta, --control,\n";
+            std::cerr << "                           --ghost-refresh)\n";
+            std::cerr << "                           | async (label-correcting buckets relaxed without phases, batches sent\n";
+            std::cerr << "                           point-to-point; uses delta but rejects\n";
+            std::cerr << "                           the delta-stepping optimizations and the --comm, --threads, --coalesce,\n";
+            std::cerr << "                           --ghost-*, --shared-mem, --control and --chunk-size options) (default: delta)\n";
+            std::cerr << "  --rho <int>              Frontier vertices a rho-stepping step relaxes at least; in radius-stepping the\n";
+            std::cerr << "                           radius of a vertex is its rho-th lightest edge (default: " << DEFAULT_RHO << ")\n";
+            std::cerr << "  --async-window <int>     Buckets above the smallest queued one anywhere that --engine async may relax\n";
+            std::cerr << "                           (default: " << DEFAULT_ASYNC_WINDOW << ")\n";
+            std::cerr << "  --async-batch <int>      Relaxations per point-to-point batch of --engine async (default: " << DEFAULT_ASYNC_BATCH << ")\n";
             std::cerr << "  --assume-nomultiedge     Skip removing multi-edges from the input graph (default: disabled)\n";
+            std::cerr << "  --graph500 <scale>       Read the Graph500 generator output of 2^scale vertices directly with MPI-IO\n";
+            std::cerr << "                           and distribute it over all processes (default: per-rank input files)\n";
+            std::cerr << "  --comm <mode>            How relaxations reach their owner: window (one MPI_Accumulate per edge)\n";
+            std::cerr << "                           | alltoallv (per-owner buffers exchanged once per phase) (default: window)\n";
+            std::cerr << "  --update-scan <mode>     How updates are found after a phase: full (scan all local vertices)\n";
+            std::cerr << "                           | dirty (only entries written this phase; needs --comm alltoallv) (default: full)\n";
+            std::cerr << "  --shared-mem / --noshared-mem  Keep distances of all ranks on a node in one shared segment and relax\n";
+            std::cerr << "                           same-node vertices by direct atomic stores; needs --comm alltoallv (default: disabled)\n";
+            std::cerr << "  --coalesce / --nocoalesce  Send at most one relaxation per target vertex per phase (default: disabled)\n";
+            std::cerr << "  --ghost-cache-mb <int>   Memory budget of the remote ghost-distance cache, 0 disables it (default: 0)\n";
+            std::cerr << "  --ghost-refresh <int>    Refresh ghost distances from owners once every N epochs, 0 never (default: 0)\n";
+            std::cerr << "  --control <mode>         Per-phase control reductions: split (work check, next bucket and settled count\n";
+            std::cerr << "                           reduced separately) | fused (one Allreduce per phase) | async (fused, MPI_Iallreduce\n";
+            std::cerr << "                           overlapped with local work) (default: split)\n";
+            std::cerr << "  --threads <int>          OpenMP threads relaxing the active set of each rank; needs a build with\n";
+            std::cerr << "                           OpenMP and excludes --local-bypass, --ghost-cache-mb and debug logging (default: 1)\n";
+            std::cerr << "  --chunk-size <int>       Relax the active set in chunks of N vertices; each chunk's relaxations are sent\n";
+            std::cerr << "                           (MPI_Isend with --comm alltoallv, MPI_Accumulate when buffered in window mode)\n";
+            std::cerr << "                           while the next one is computed, and arrived chunks are applied in between;\n";
+            std::cerr << "                           0 relaxes the active set in one piece (default: 0)\n";
+            std::cerr << "  --output-mode <mode>     per-rank (one text file per rank) | shared (one text file written collectively\n";
+            std::cerr << "                           with MPI-IO) | binary (one file of int64 distances by global vertex id)\n";
+            std::cerr << "                           (default: per-rank)\n";
             std::cerr << "  --logging <level>        Set logging level: none | progress | debug (default: progress)\n";
             std::cerr << "  --progress-freq <int>    Report progress once every N epochs (default: 10)\n";
             std::cerr << std::endl;
@@ -570,7 +1192,8 @@ int main(int argc, char *argv[])
     }
     std::string input_filename = argv[1];
     std::string output_filename = argv[2];
-    long long delta_param = (argc > 3) ? std::stoll(argv[3]) : DEFAULT_DELTA;
+    bool delta_auto = argc > 3 && std::string(argv[3]) == "auto";
+    long long delta_param = (argc > 3 && !delta_auto) ? std::stoll(argv[3]) : DEFAULT_DELTA;
 
     // assumption: delta CLI arg is hardcoded in mpirun script, so it will be the same everywhere
     if (delta_param <= 0)
@@ -586,7 +1209,25 @@ int main(int argc, char *argv[])
     bool enable_pruning = false;
     bool enable_local_bypass = false;
     bool enable_hybridization = true;
+    long long hybrid_phase_cost = DEFAULT_HYBRID_PHASE_COST;
+    bool enable_adaptive_delta = false;
+    Engine engine = Engine::Delta;
+    size_t rho_param = DEFAULT_RHO;
+    long long async_window = DEFAULT_ASYNC_WINDOW;
+    size_t async_batch = DEFAULT_ASYNC_BATCH;
     bool assume_nomultiedge = false;
+    int graph500_scale = 0;
+    CommMode comm_mode = CommMode::Window;
+    bool enable_coalescing = false;
+    bool enable_shared_memory = false;
+    bool enable_dirty_tracking = false;
+    int ghost_cache_mb = 0;
+    int ghost_refresh_freq = 0;
+    bool fused_control = false;
+    int n_threads = 1;
+    long long chunk_size = 0;
+    bool async_control = false;
+    OutputMode output_mode = OutputMode::PerRank;
 
     int progress_freq = DEFAULT_PROGESS_FREQ;
 
@@ -626,25 +1267,333 @@ int main(int argc, char *argv[])
         {
             enable_hybridization = false;
         }
+        else if (arg == "--adaptive-delta")
+        {
+            enable_adaptive_delta = true;
+        }
+        else if (arg == "--noadaptive-delta")
+        {
+            enable_adaptive_delta = false;
+        }
         else if (arg == "--assume-nomultiedge")
         {
             assume_nomultiedge = true;
         }
-        else if (arg == "--logging")
+        else if (arg == "--graph500")
         {
             if (i + 1 >= argc)
             {
                 if (myRank == 0)
-                    std::cerr << "--logging requires an argument: none, progress, or debug" << std::endl;
+                    std::cerr << "--graph500 requires an integer argument" << std::endl;
                 MPI_Finalize();
                 return 1;
             }
-            std::string level = argv[++i];
-            if (level == "none")
-                logging_level = LoggingLevel::None;
-            else if (level == "progress")
-                logging_level = LoggingLevel::Progress;
-            else if (level == "debug")
+            try
+            {
+                graph500_scale = std::stoi(argv[++i]);
+                if (graph500_scale <= 0)
+                    throw std::invalid_argument("must be > 0");
+            }
+            catch (const std::exception &e)
+            {
+                if (myRank == 0)
+                    std::cerr << "Invalid value for --graph500: " << e.what() << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+        }
+        else if (arg == "--shared-mem")
+        {
+            enable_shared_memory = true;
+        }
+        else if (arg == "--noshared-mem")
+        {
+            enable_shared_memory = false;
+        }
+        else if (arg == "--coalesce")
+        {
+            enable_coalescing = true;
+        }
+        else if (arg == "--nocoalesce")
+        {
+            enable_coalescing = false;
+        }
+        else if (arg == "--threads")
+        {
+            if (i + 1 >= argc)
+            {
+                if (myRank == 0)
+                    std::cerr << "--threads requires an integer argument" << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+            try
+            {
+                n_threads = std::stoi(argv[++i]);
+                if (n_threads <= 0)
+                    throw std::invalid_argument("must be > 0");
+            }
+            catch (const std::exception &e)
+            {
+                if (myRank == 0)
+                    std::cerr << "Invalid value for --threads: " << e.what() << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+        }
+        else if (arg == "--chunk-size")
+        {
+            if (i + 1 >= argc)
+            {
+                if (myRank == 0)
+                    std::cerr << "--chunk-size requires an integer argument" << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+            try
+            {
+                chunk_size = std::stoll(argv[++i]);
+                if (chunk_size < 0)
+                    throw std::invalid_argument("must be >= 0");
+            }
+            catch (const std::exception &e)
+            {
+                if (myRank == 0)
+                    std::cerr << "Invalid value for --chunk-size: " << e.what() << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+        }
+        else if (arg == "--ghost-cache-mb" || arg == "--ghost-refresh")
+        {
+            if (i + 1 >= argc)
+            {
+                if (myRank == 0)
+                    std::cerr << arg << " requires an integer argument" << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+            try
+            {
+                int value = std::stoi(argv[++i]);
+                if (value < 0)
+                    throw std::invalid_argument("must be >= 0");
+                (arg == "--ghost-cache-mb" ? ghost_cache_mb : ghost_refresh_freq) = value;
+            }
+            catch (const std::exception &e)
+            {
+                if (myRank == 0)
+                    std::cerr << "Invalid value for " << arg << ": " << e.what() << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+        }
+        else if (arg == "--update-scan")
+        {
+            if (i + 1 >= argc)
+            {
+                if (myRank == 0)
+                    std::cerr << "--update-scan requires an argument: full or dirty" << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+            std::string mode = argv[++i];
+            if (mode == "full")
+                enable_dirty_tracking = false;
+            else if (mode == "dirty")
+                enable_dirty_tracking = true;
+            else
+            {
+                if (myRank == 0)
+                    std::cerr << "Invalid value for --update-scan: " << mode << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+        }
+        else if (arg == "--control")
+        {
+            if (i + 1 >= argc)
+            {
+                if (myRank == 0)
+                    std::cerr << "--control requires an argument: split, fused or async" << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+            std::string mode = argv[++i];
+            if (mode == "split" || mode == "fused" || mode == "async")
+            {
+                fused_control = mode != "split";
+                async_control = mode == "async";
+            }
+            else
+            {
+                if (myRank == 0)
+                    std::cerr << "Invalid value for --control: " << mode << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+        }
+        else if (arg == "--engine")
+        {
+            if (i + 1 >= argc)
+            {
+                if (myRank == 0)
+                    std::cerr << "--engine requires an argument: delta, rho, radius or async" << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+            std::string name = argv[++i];
+            if (name == "delta")
+                engine = Engine::Delta;
+            else if (name == "rho")
+                engine = Engine::Rho;
+            else if (name == "radius")
+                engine = Engine::Radius;
+            else if (name == "async")
+                engine = Engine::Async;
+            else
+            {
+                if (myRank == 0)
+                    std::cerr << "Invalid value for --engine: " << name << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+        }
+        else if (arg == "--rho")
+        {
+            if (i + 1 >= argc)
+            {
+                if (myRank == 0)
+                    std::cerr << "--rho requires an integer argument" << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+            try
+            {
+                auto value = std::stoll(argv[++i]);
+                if (value <= 0)
+                    throw std::invalid_argument("must be > 0");
+                rho_param = static_cast<size_t>(value);
+            }
+            catch (const std::exception &e)
+            {
+                if (myRank == 0)
+                    std::cerr << "Invalid value for --rho: " << e.what() << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+        }
+        else if (arg == "--hybrid-phase-cost")
+        {
+            if (i + 1 >= argc)
+            {
+                if (myRank == 0)
+                    std::cerr << "--hybrid-phase-cost requires an integer argument" << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+            try
+            {
+                hybrid_phase_cost = std::stoll(argv[++i]);
+                if (hybrid_phase_cost <= 0)
+                    throw std::invalid_argument("must be > 0");
+            }
+            catch (const std::exception &e)
+            {
+                if (myRank == 0)
+                    std::cerr << "Invalid value for --hybrid-phase-cost: " << e.what() << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+        }
+        else if (arg == "--async-window" || arg == "--async-batch")
+        {
+            if (i + 1 >= argc)
+            {
+                if (myRank == 0)
+                    std::cerr << arg << " requires an integer argument" << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+            try
+            {
+                auto value = std::stoll(argv[++i]);
+                if (value <= 0)
+                    throw std::invalid_argument("must be > 0");
+                if (arg == "--async-window")
+                    async_window = value;
+                else
+                    async_batch = static_cast<size_t>(value);
+            }
+            catch (const std::exception &e)
+            {
+                if (myRank == 0)
+                    std::cerr << "Invalid value for " << arg << ": " << e.what() << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+        }
+        else if (arg == "--comm")
+        {
+            if (i + 1 >= argc)
+            {
+                if (myRank == 0)
+                    std::cerr << "--comm requires an argument: window or alltoallv" << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+            std::string mode = argv[++i];
+            if (mode == "window")
+                comm_mode = CommMode::Window;
+            else if (mode == "alltoallv")
+                comm_mode = CommMode::Alltoallv;
+            else
+            {
+                if (myRank == 0)
+                    std::cerr << "Invalid value for --comm: " << mode << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+        }
+        else if (arg == "--output-mode")
+        {
+            if (i + 1 >= argc)
+            {
+                if (myRank == 0)
+                    std::cerr << "--output-mode requires an argument: per-rank, shared or binary" << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+            std::string mode = argv[++i];
+            if (mode == "per-rank")
+                output_mode = OutputMode::PerRank;
+            else if (mode == "shared")
+                output_mode = OutputMode::Shared;
+            else if (mode == "binary")
+                output_mode = OutputMode::Binary;
+            else
+            {
+                if (myRank == 0)
+                    std::cerr << "Invalid value for --output-mode: " << mode << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+        }
+        else if (arg == "--logging")
+        {
+            if (i + 1 >= argc)
+            {
+                if (myRank == 0)
+                    std::cerr << "--logging requires an argument: none, progress, or debug" << std::endl;
+                MPI_Finalize();
+                return 1;
+            }
+            std::string level = argv[++i];
+            if (level == "none")
+                logging_level = LoggingLevel::None;
+            else if (level == "progress")
+                logging_level = LoggingLevel::Progress;
+            else if (level == "debug")
                 logging_level = LoggingLevel::Debug;
             else
             {
@@ -686,19 +1635,157 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (enable_pruning && !enable_ios_optimizations)
+    {
+        if (myRank == 0)
+            std::cerr << "--pruning requires --ios" << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+    if (hybrid_phase_cost != DEFAULT_HYBRID_PHASE_COST && !enable_hybridization)
+    {
+        if (myRank == 0)
+            std::cerr << "--hybrid-phase-cost requires --hybrid" << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+    if (enable_dirty_tracking && comm_mode == CommMode::Window)
+    {
+        if (myRank == 0)
+            std::cerr << "--update-scan dirty requires --comm alltoallv" << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+    if (enable_shared_memory && (comm_mode == CommMode::Window || enable_dirty_tracking))
+    {
+        if (myRank == 0)
+            std::cerr << "--shared-mem requires --comm alltoallv and --update-scan full" << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+
+    if (engine == Engine::Rho || engine == Engine::Radius)
+    {
+        // the frontier engines have no buckets, epochs or Bellman-Ford switch for these to act on
+        std::string conflict;
+        if (!enable_ios_optimizations)
+            conflict = "--noios";
+        if (enable_pruning)
+            conflict = "--pruning";
+        if (enable_local_bypass)
+            conflict = "--local-bypass";
+        if (!enable_hybridization)
+            conflict = "--nohybrid";
+        if (hybrid_phase_cost != DEFAULT_HYBRID_PHASE_COST)
+            conflict = "--hybrid-phase-cost";
+        if (enable_adaptive_delta)
+            conflict = "--adaptive-delta";
+        if (fused_control)
+            conflict = "--control fused|async";
+        if (ghost_refresh_freq > 0)
+            conflict = "--ghost-refresh";
+        if (!conflict.empty())
+        {
+            if (myRank == 0)
+                std::cerr << "--engine rho|radius does not support " << conflict << std::endl;
+            MPI_Finalize();
+            return 1;
+        }
+    }
+    if (engine == Engine::Async)
+    {
+        // the async engine has its own point-to-point exchange and no phases: none of these would take effect
+        std::string conflict;
+        if (comm_mode != CommMode::Window)
+            conflict = "--comm";
+        if (n_threads > 1)
+            conflict = "--threads";
+        if (enable_coalescing)
+            conflict = "--coalesce";
+        if (ghost_cache_mb > 0 || ghost_refresh_freq > 0)
+            conflict = "--ghost-cache-mb / --ghost-refresh";
+        if (enable_shared_memory)
+            conflict = "--shared-mem";
+        if (enable_dirty_tracking)
+            conflict = "--update-scan dirty";
+        if (fused_control)
+            conflict = "--control fused|async";
+        if (enable_pruning)
+            conflict = "--pruning";
+        if (enable_local_bypass)
+            conflict = "--local-bypass";
+        if (enable_adaptive_delta)
+            conflict = "--adaptive-delta";
+        if (hybrid_phase_cost != DEFAULT_HYBRID_PHASE_COST)
+            conflict = "--hybrid-phase-cost";
+        if (chunk_size > 0)
+            conflict = "--chunk-size";
+        if (!conflict.empty())
+        {
+            if (myRank == 0)
+                std::cerr << "--engine async does not support " << conflict << std::endl;
+            MPI_Finalize();
+            return 1;
+        }
+    }
+
+    if (n_threads > 1)
+    {
+        std::string conflict;
+#ifndef _OPENMP
+        conflict = "a build with OpenMP";
+#endif
+        if (threadSupport < MPI_THREAD_FUNNELED)
+            conflict = "MPI_THREAD_FUNNELED support";
+        if (enable_local_bypass)
+            conflict = "--nolocal-bypass";
+        if (ghost_cache_mb > 0)
+            conflict = "--ghost-cache-mb 0";
+        if (logging_level == LoggingLevel::Debug)
+            conflict = "--logging other than debug";
+        if (!conflict.empty())
+        {
+            if (myRank == 0)
+                std::cerr << "--threads > 1 requires " << conflict << std::endl;
+            MPI_Finalize();
+            return 1;
+        }
+#ifdef _OPENMP
+        omp_set_num_threads(n_threads);
+#endif
+    }
+
     PROGRESSN("Starting to parse data!");
     PROGRESSN("Log level: >= progress");
     DEBUGN("Log level: >= debug");
     std::cout.setf(std::ios::unitbuf); // auto-flush std::cout
     std::cerr.setf(std::ios::unitbuf); // auto-flush std::cerr
-    if (myRank == 0) std::cerr << "std::cerr test";
-    if (myRank == 0) ERROR("(this is a test of error log displaying)");
 
     double start_time1 = MPI_Wtime();
-    auto dataOpt = process_input_and_load_graph_from_stream(myRank, input_filename, assume_nomultiedge);
+    auto dataOpt = graph500_scale > 0
+                       ? load_graph500_edges(myRank, input_filename, graph500_scale, assume_nomultiedge)
+                       : process_input_and_load_graph_from_stream(myRank, input_filename, assume_nomultiedge);
     double end_time1 = MPI_Wtime();
     if (myRank == 0)
         std::cout << "Parsing data took: " << end_time1 - start_time1 << "s\n";
+    if (dataOpt.has_value())
+    {
+        // adjacency while loading, after finalizing, and the process's peak resident memory (ru_maxrss is in KiB)
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        unsigned long long localLoad[3] = {dataOpt->getAdjacencyBytesBefore(), dataOpt->getAdjacencyBytesAfter(),
+                                           static_cast<unsigned long long>(usage.ru_maxrss) * 1024};
+        unsigned long long sumLoad[3] = {0, 0, 0}, maxLoad[3] = {0, 0, 0};
+        MPI_CALL(MPI_Reduce(localLoad, sumLoad, 3, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD));
+        MPI_CALL(MPI_Reduce(localLoad, maxLoad, 3, MPI_UNSIGNED_LONG_LONG, MPI_MAX, 0, MPI_COMM_WORLD));
+        if (myRank == 0)
+        {
+            std::cout << "Adjacency per rank while loading: " << sumLoad[0] / nProcessorsGlobal << "B avg, " << maxLoad[0]
+                      << "B max; CSR: " << sumLoad[1] / nProcessorsGlobal << "B avg, " << maxLoad[1] << "B max\n";
+            std::cout << "Peak memory after load per rank: " << sumLoad[2] / nProcessorsGlobal / (1 << 20) << "MiB avg, "
+                      << maxLoad[2] / (1 << 20) << "MiB max\n";
+        }
+    }
 
     if (!dataOpt.has_value())
     {
@@ -707,6 +1794,21 @@ int main(int argc, char *argv[])
         return 1;
     }
     auto &data = *dataOpt;
+    if (delta_auto)
+    {
+        auto choice = chooseDelta(reduceGraphStats(localGraphStats(data)), data.getNVerticesGlobal(), DEFAULT_DELTA);
+        delta_param = choice.delta;
+        if (myRank == 0)
+            std::cout << "Delta auto: " << delta_param << " = " << choice.reason << "\n";
+    }
+    data.setCommMode(comm_mode);
+    if (enable_shared_memory)
+        data.enableSharedMemory();
+    data.setCoalescing(enable_coalescing);
+    data.setDirtyTracking(enable_dirty_tracking);
+    data.setGhostCacheBudget(static_cast<size_t>(ghost_cache_mb) * 1024 * 1024);
+    data.setThreads(n_threads);
+    data.setChunkSize(static_cast<size_t>(chunk_size));
 
     BlockDistribution::Distribution dist(nProcessorsGlobal, data.getNVerticesGlobal());
     auto distNRespOpt = dist.getNResponsibleVertices(myRank);
@@ -743,8 +1845,23 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    std::ofstream outfile_stream(output_filename);
-    if (!outfile_stream.is_open())
+    try
+    {
+        // binary graphs may come with targets already resolved for this number of processes
+        if (!data.hasResolvedTargets())
+            data.resolveTargets(dist);
+    }
+    catch (InvalidData &ex)
+    {
+        ERROR("Unable to resolve edge targets: ", ex.what());
+        MPI_Abort(MPI_COMM_WORLD, 1);
+        return 1;
+    }
+
+    std::ofstream outfile_stream;
+    if (output_mode == OutputMode::PerRank)
+        outfile_stream.open(output_filename, std::ios::binary);
+    if (output_mode == OutputMode::PerRank && !outfile_stream.is_open())
     {
         std::cerr << "Rank " << myRank << ": Cannot open " << output_filename << std::endl;
         MPI_Abort(MPI_COMM_WORLD, 1);
@@ -754,11 +1871,32 @@ int main(int argc, char *argv[])
     MPI_Barrier(MPI_COMM_WORLD);
     DEBUGN("Starting delta stepping!");
     double start_time = MPI_Wtime();
+    unsigned long long controlReductions = 0;
+    std::optional<DeltaAdaptation> adaptation;
+    if (enable_adaptive_delta && engine == Engine::Delta)
+        adaptation.emplace(delta_param);
     try
     {
-        delta_stepping_algorithm(data, dist, 0, delta_param, progress_freq,
-                                 enable_ios_optimizations, enable_pruning, enable_local_bypass,
-                                 enable_hybridization);
+        if (engine == Engine::Delta)
+        {
+            std::optional<ControlReduction> control;
+            if (fused_control)
+                control.emplace(async_control);
+            delta_stepping_algorithm(data, 0, delta_param, progress_freq,
+                                     enable_ios_optimizations, enable_pruning, enable_local_bypass,
+                                     enable_hybridization, hybrid_phase_cost, ghost_refresh_freq, control ? &*control : nullptr,
+                                     adaptation ? &*adaptation : nullptr);
+            if (control)
+                controlReductions = control->getNReductions();
+        }
+        else if (engine == Engine::Async)
+        {
+            async_relaxation_algorithm(data, 0, delta_param, async_window, async_batch, progress_freq);
+        }
+        else
+        {
+            frontier_stepping_algorithm(data, 0, engine, rho_param, progress_freq);
+        }
     }
     catch (Fatal &ex)
     {
@@ -766,36 +1904,141 @@ int main(int argc, char *argv[])
         MPI_Abort(MPI_COMM_WORLD, 1);
         return 1;
     }
+    catch (BucketQueue::InvalidBucket &ex)
+    {
+        ERROR("Bucket error while Delta-stepping: ", ex.what());
+        MPI_Abort(MPI_COMM_WORLD, 1);
+        return 1;
+    }
+    catch (InvalidData &ex)
+    {
+        ERROR("Data error while Delta-stepping: ", ex.what());
+        MPI_Abort(MPI_COMM_WORLD, 1);
+        return 1;
+    }
     MPI_Barrier(MPI_COMM_WORLD); // Ensure all processes done before anyone exits/prints final time
     double end_time = MPI_Wtime();
 
     long long globalRelaxationsShort = 0;
     long long globalRelaxationsLong = 0;
     long long globalRelaxationsBypassed = 0;
+    unsigned long long globalRelaxationsCoalesced = 0;
+    unsigned long long relaxationsCoalesced = data.getNCoalesced();
+    unsigned long long relaxationsShared = data.getNSharedRelaxations();
+    unsigned long long globalRelaxationsShared = 0;
+    unsigned long long ghostCounters[3] = {
+        data.getGhostCache().getNLookups(), data.getGhostCache().getNHits(), data.getNGhostsRefreshed()};
+    unsigned long long globalGhostCounters[3] = {0, 0, 0};
+    unsigned long long pruningCounters[3] = {relaxationsAvoided, pullRequests, pullResponses};
+    unsigned long long globalPruningCounters[3] = {0, 0, 0};
+    unsigned long long asyncCounters[2] = {asyncBatchesSent, asyncRelaxationsSent};
+    unsigned long long globalAsyncCounters[2] = {0, 0};
+    double globalAsyncIdleTime = 0;
+    double relaxationTimes[3] = {timeRelaxing, timeBetweenChunks, timeAtBarrier};
+    double maxRelaxationTimes[3] = {0, 0, 0};
+    unsigned long long chunksSent = data.getNChunksSent(), globalChunksSent = 0;
     // long long globalPhasesBeitforeBellman = 0;
 
     // Reduce (sum) the counters across all processes
     MPI_CALL(MPI_Reduce(&relaxationsShort, &globalRelaxationsShort, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD));
     MPI_CALL(MPI_Reduce(&relaxationsLong, &globalRelaxationsLong, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD));
     MPI_CALL(MPI_Reduce(&relaxationsBypassed, &globalRelaxationsBypassed, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD));
+    MPI_CALL(MPI_Reduce(&relaxationsCoalesced, &globalRelaxationsCoalesced, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD));
+    MPI_CALL(MPI_Reduce(&relaxationsShared, &globalRelaxationsShared, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD));
+    MPI_CALL(MPI_Reduce(ghostCounters, globalGhostCounters, 3, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD));
+    MPI_CALL(MPI_Reduce(pruningCounters, globalPruningCounters, 3, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD));
+    MPI_CALL(MPI_Reduce(asyncCounters, globalAsyncCounters, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD));
+    MPI_CALL(MPI_Reduce(&asyncIdleTime, &globalAsyncIdleTime, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD));
+    MPI_CALL(MPI_Reduce(relaxationTimes, maxRelaxationTimes, 3, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD));
+    MPI_CALL(MPI_Reduce(&chunksSent, &globalChunksSent, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD));
     // MPI_CALL(MPI_Reduce(&phasesBeforeBellman, &globalPhasesBeforeBellman, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD));
 
     if (myRank == 0)
     {
-        std::cout << "Delta-stepping (one-sided) finished.\n";
+        const char *engineName = engine == Engine::Delta ? "Delta-stepping"
+                                 : engine == Engine::Rho ? "Rho-stepping"
+                                 : engine == Engine::Radius ? "Radius-stepping"
+                                                            : "Async delta-stepping";
+        std::cout << engineName << " ("
+                  << (engine == Engine::Async ? "point-to-point" : comm_mode == CommMode::Window ? "one-sided" : "alltoallv");
+        if (n_threads > 1)
+            std::cout << ", " << n_threads << " threads per rank";
+        std::cout << ") finished.\n";
         std::cout << "Time: " << (end_time - start_time) << "s." << std::endl;
         std::cout << "Short relaxations: " << globalRelaxationsShort << std::endl;
         std::cout << "  from which bypassed: " << globalRelaxationsBypassed << std::endl;
         std::cout << "Long relaxations: " << globalRelaxationsLong << std::endl;
+        std::cout << "Coalesced relaxations: " << globalRelaxationsCoalesced << std::endl;
+        if (enable_shared_memory)
+            std::cout << "Shared-memory relaxations: " << globalRelaxationsShared << std::endl;
+        if (ghost_cache_mb > 0)
+        {
+            std::cout << "Ghost cache hits: " << globalGhostCounters[1] << " / " << globalGhostCounters[0] << " lookups ("
+                      << (globalGhostCounters[0] == 0 ? 0.0 : 100.0 * globalGhostCounters[1] / globalGhostCounters[0]) << "%, "
+                      << ghost_cache_mb << "MB per rank, " << globalGhostCounters[2] << " entries refreshed)" << std::endl;
+        }
+        if (enable_pruning)
+        {
+            std::cout << "Pruning: " << longPhasesPulled << " of " << longPhasesConsidered << " long phases pulled, "
+                      << globalPruningCounters[0] << " long relaxations avoided (" << globalPruningCounters[1]
+                      << " pull requests, " << globalPruningCounters[2] << " answers)" << std::endl;
+        }
+        if (adaptation)
+        {
+            std::cout << "Adaptive delta: " << adaptation->getNChanges() << " changes, between " << adaptation->getMinDelta()
+                      << " and " << adaptation->getMaxDelta() << ", final " << adaptation->getDelta() << std::endl;
+        }
+        if (chunk_size > 0)
+        {
+            std::cout << "Pipelined relaxation: chunks of " << chunk_size << " vertices, " << globalChunksSent
+                      << " sent before their phase ended; per rank (max) " << maxRelaxationTimes[0] << "s computing, "
+                      << maxRelaxationTimes[1] << "s between chunks, " << maxRelaxationTimes[2] << "s waiting at phase ends"
+                      << std::endl;
+        }
+        if (engine == Engine::Async)
+        {
+            std::cout << "Async: " << globalAsyncCounters[1] << " remote relaxations in " << globalAsyncCounters[0]
+                      << " batches, window " << async_window << " buckets, idle up to " << globalAsyncIdleTime
+                      << "s per rank" << std::endl;
+        }
         std::cout << "Total phases: " << totalPhases << std::endl;
+        std::cout << "Total collectives: " << totalCollectives + controlReductions + data.getNCollectives()
+                  << " (" << (fused_control ? (async_control ? "async fused" : "fused") : "split") << " control)" << std::endl;
         std::cout << "Last phase before bellman: " << phasesBeforeBellman << std::endl;
+        for (const auto &hybridSwitch : hybridSwitches)
+        {
+            std::cout << "Hybridization switch at " << hybridSwitch << std::endl;
+        }
     }
 
-    for (size_t i = 0; i < data.getNResponsible(); ++i)
+    double output_start = MPI_Wtime();
+    bool written;
+    if (output_mode == OutputMode::PerRank)
     {
-        outfile_stream << (data.data()[i] == INF ? -1 : data.data()[i]) << std::endl;
+        auto text = formatDistances(data.data(), data.getNResponsible());
+        outfile_stream.write(text.data(), text.size());
+        outfile_stream.close();
+        written = !outfile_stream.fail();
     }
-    outfile_stream.close();
+    else if (output_mode == OutputMode::Shared)
+    {
+        written = writeDistancesShared(output_filename, data.data(), data.getNResponsible());
+    }
+    else
+    {
+        written = writeDistancesBinary(output_filename, data.data(), data.getNResponsible(),
+                                       data.getFirstResponsibleGlobalIdx(), data.getNVerticesGlobal());
+    }
+    if (!written)
+    {
+        std::cerr << "Rank " << myRank << ": Failed to write " << output_filename << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+        return 1;
+    }
+    double output_time = MPI_Wtime() - output_start, max_output_time = 0;
+    MPI_CALL(MPI_Reduce(&output_time, &max_output_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD));
+    if (myRank == 0)
+        std::cout << "Writing output took: " << max_output_time << "s\n";
 
     data.freeWindow();
     MPI_Finalize();
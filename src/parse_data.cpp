@@ -1,39 +1,277 @@
-#include <fstream>
-#include <sstream>
 #include <optional>
+#include <charconv>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "parse_data.hpp"
+#include "block_dist.hpp"
+
+namespace {
+
+/// @brief Read-only memory mapping of a whole file; unmapped on destruction.
+class MappedFile {
+    int fd = -1;
+    const char *begin_ = nullptr;
+    size_t size_ = 0;
+
+public:
+    explicit MappedFile(const std::string& path) {
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            return;
+        }
+        void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            return;
+        }
+        madvise(addr, st.st_size, MADV_SEQUENTIAL);
+        begin_ = static_cast<const char *>(addr);
+        size_ = st.st_size;
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (begin_ != nullptr) {
+            munmap(const_cast<char *>(begin_), size_);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    bool isOpen() const { return fd >= 0; }
+    const char *begin() const { return begin_; }
+    const char *end() const { return begin_ + size_; }
+};
+
+/// @brief Parse `n` whitespace-separated integers from the line `[p, lineEnd)`. Anything after them is ignored,
+/// like the `istringstream` extraction this replaces.
+template <typename T>
+bool parseFields(const char *p, const char *lineEnd, T *out, int n) {
+    for (int i = 0; i < n; ++i) {
+        while (p < lineEnd && (*p == ' ' || *p == '\t' || *p == '\r')) {
+            ++p;
+        }
+        auto [next, ec] = std::from_chars(p, lineEnd, out[i]);
+        if (ec != std::errc()) {
+            return false;
+        }
+        p = next;
+    }
+    return true;
+}
+
+const char *lineEndOf(const char *p, const char *end) {
+    auto newline = static_cast<const char *>(memchr(p, '\n', end - p));
+    return newline == nullptr ? end : newline;
+}
+
+struct InputEdge {
+    long long u;
+    long long v;
+    long long weight;
+};
+
+/// @brief pread `bytes` at `offset`, retrying short reads
+bool readFully(int fd, void *buf, size_t bytes, off_t offset) {
+    auto *p = static_cast<char *>(buf);
+    while (bytes > 0) {
+        auto n = pread(fd, p, bytes, offset);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        bytes -= n;
+        offset += n;
+    }
+    return true;
+}
+
+bool writeFully(int fd, const void *buf, size_t bytes, off_t offset) {
+    auto *p = static_cast<const char *>(buf);
+    while (bytes > 0) {
+        auto n = pwrite(fd, p, bytes, offset);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        bytes -= n;
+        offset += n;
+    }
+    return true;
+}
+
+bool hasBinaryMagic(const std::string& input_filename) {
+    int fd = open(input_filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    char magic[sizeof(BinaryGraphHeader::MAGIC)];
+    bool binary = readFully(fd, magic, sizeof(magic), 0) && memcmp(magic, BinaryGraphHeader::MAGIC, sizeof(magic)) == 0;
+    close(fd);
+    return binary;
+}
+
+/// @brief Load a `BinaryGraphHeader` file: one read per CSR array, straight into the vectors `Data` keeps.
+std::optional<Data> load_binary_graph(int myRank, const std::string& input_filename) {
+    int fd = open(input_filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Rank " << myRank << ": Cannot open " << input_filename << std::endl;
+        return {};
+    }
+    BinaryGraphHeader header;
+    if (!readFully(fd, &header, sizeof(header), 0) || header.version != BinaryGraphHeader::VERSION) {
+        std::cerr << "Rank " << myRank << ": Unsupported binary graph header" << std::endl;
+        close(fd);
+        return {};
+    }
+    int nProcessors;
+    MPI_Comm_size(MPI_COMM_WORLD, &nProcessors);
+    bool resolved = header.flags & BinaryGraphHeader::TARGETS_RESOLVED;
+    if (resolved && header.nProcessors != static_cast<uint64_t>(nProcessors)) {
+        std::cerr << "Rank " << myRank << ": Binary graph was resolved for " << header.nProcessors
+                  << " processes, running on " << nProcessors << std::endl;
+        close(fd);
+        return {};
+    }
+
+    std::vector<size_t> offsets(header.nLocalResponsible + 1);
+    std::vector<VertexRef> targets(header.nEdges);
+    std::vector<long long> weights(header.nEdges);
+    off_t pos = sizeof(header);
+    bool ok = readFully(fd, offsets.data(), offsets.size() * sizeof(size_t), pos);
+    pos += offsets.size() * sizeof(size_t);
+    ok = ok && readFully(fd, targets.data(), targets.size() * sizeof(VertexRef), pos);
+    pos += targets.size() * sizeof(VertexRef);
+    ok = ok && readFully(fd, weights.data(), weights.size() * sizeof(long long), pos);
+    close(fd);
+    if (!ok) {
+        std::cerr << "Rank " << myRank << ": Binary graph truncated" << std::endl;
+        return {};
+    }
+
+    try {
+        Data data(header.firstResponsibleGlobalIdx, header.nLocalResponsible, header.nVerticesGlobal);
+        data.adoptAdjacency(std::move(offsets), std::move(targets), std::move(weights), resolved, nProcessors);
+        return data;
+    } catch (InvalidData& ex) {
+        std::cerr << "Failed to load binary graph: " << ex.what() << std::endl;
+        return {};
+    }
+}
+
+/// @brief Graph500 edge record: two 6-byte little-endian vertex ids (`GENERATOR_USE_PACKED_EDGE_TYPE`)
+constexpr size_t GRAPH500_EDGE_BYTES = 12;
+/// @brief Graph500 weight record: one float in [0, 1)
+constexpr size_t GRAPH500_WEIGHT_BYTES = 4;
+/// @brief edges every rank reads and shuffles per collective round; bounds the staging buffers
+constexpr size_t GRAPH500_EDGES_PER_ROUND = 1 << 22;
+
+uint64_t decodeGraph500Vertex(const unsigned char *p, uint64_t mask) {
+    uint64_t val = 0;
+    for (int i = 0; i < 6; ++i) {
+        val |= static_cast<uint64_t>(p[i]) << (i * 8);
+    }
+    return val & mask;
+}
+
+/// @brief `int(w * 256) % 256`, the integer weights `split.cpp` writes
+long long decodeGraph500Weight(const unsigned char *p) {
+    float w;
+    memcpy(&w, p, sizeof(w));
+    return static_cast<int>(w * 256) % 256;
+}
+
+/// @brief Collectively read `count` records of `recordBytes` starting at record `first`.
+/// Every rank must call it, possibly with `count == 0`.
+bool readRecordsAll(MPI_File fh, size_t first, size_t count, size_t recordBytes, unsigned char *buf) {
+    MPI_Status status;
+    int err = MPI_File_read_at_all(fh, static_cast<MPI_Offset>(first * recordBytes), buf,
+                                   static_cast<int>(count * recordBytes), MPI_BYTE, &status);
+    int nRead = 0;
+    MPI_Get_count(&status, MPI_BYTE, &nRead);
+    return err == MPI_SUCCESS && static_cast<size_t>(nRead) == count * recordBytes;
+}
+
+} // namespace
+
+bool save_graph_binary(const Data& data, const std::string& output_filename, size_t nProcessors) {
+    const auto& offsets = data.getAdjOffsets();
+    const auto& targets = data.getAdjTargets();
+    const auto& weights = data.getAdjWeights();
+    if (offsets.size() != data.getNResponsible() + 1) {
+        std::cerr << "Adjacency must be finalized before saving" << std::endl;
+        return false;
+    }
+
+    BinaryGraphHeader header;
+    memcpy(header.magic, BinaryGraphHeader::MAGIC, sizeof(header.magic));
+    header.version = BinaryGraphHeader::VERSION;
+    header.flags = data.hasResolvedTargets() ? BinaryGraphHeader::TARGETS_RESOLVED : 0;
+    header.nVerticesGlobal = data.getNVerticesGlobal();
+    header.firstResponsibleGlobalIdx = data.getFirstResponsibleGlobalIdx();
+    header.nLocalResponsible = data.getNResponsible();
+    header.nEdges = targets.size();
+    header.nProcessors = nProcessors;
+
+    int fd = open(output_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Cannot open " << output_filename << std::endl;
+        return false;
+    }
+    off_t pos = 0;
+    bool ok = writeFully(fd, &header, sizeof(header), pos);
+    pos += sizeof(header);
+    ok = ok && writeFully(fd, offsets.data(), offsets.size() * sizeof(size_t), pos);
+    pos += offsets.size() * sizeof(size_t);
+    ok = ok && writeFully(fd, targets.data(), targets.size() * sizeof(VertexRef), pos);
+    pos += targets.size() * sizeof(VertexRef);
+    ok = ok && writeFully(fd, weights.data(), weights.size() * sizeof(long long), pos);
+    ok = close(fd) == 0 && ok;
+    if (!ok) {
+        std::cerr << "Failed to write " << output_filename << std::endl;
+    }
+    return ok;
+}
 
 std::optional<Data> process_input_and_load_graph_from_stream(
     int myRank,
     const std::string& input_filename,
     bool assume_nomultiedge
 ) {
-    std::ifstream instream(input_filename);
-    if (!instream.is_open()) {
+    if (hasBinaryMagic(input_filename)) {
+        return load_binary_graph(myRank, input_filename);
+    }
+
+    MappedFile file(input_filename);
+    if (!file.isOpen()) {
         std::cerr << "Rank " << myRank << ": Cannot open " << input_filename << std::endl;
         return {};
     }
-
-    size_t nVerticesGlobal;
-    size_t firstResponsibleGlobalIdx;
-    size_t lastResponsibleGlobalIdx;
-
-    std::string line;
-    if (!std::getline(instream, line)) {
+    if (file.begin() == nullptr) {
         std::cerr << "Rank " << myRank << ": Fail read L1" << std::endl;
         return {};
     }
 
-    std::istringstream iss_first_line(line);
-    if (!(iss_first_line
-            >> nVerticesGlobal
-            >> firstResponsibleGlobalIdx
-            >> lastResponsibleGlobalIdx
-        )
-    ) {
+    size_t header[3]; // nVerticesGlobal, firstResponsibleGlobalIdx, lastResponsibleGlobalIdx
+    const char *p = file.begin();
+    const char *lineEnd = lineEndOf(p, file.end());
+    if (!parseFields(p, lineEnd, header, 3)) {
         std::cerr << "Rank " << myRank << ": Fail parse L1" << std::endl;
         return {};
     }
+    size_t nVerticesGlobal = header[0];
+    size_t firstResponsibleGlobalIdx = header[1];
+    size_t lastResponsibleGlobalIdx = header[2];
 
     if (lastResponsibleGlobalIdx  < firstResponsibleGlobalIdx) {
         std::cerr << "Rank " << myRank << ": lastResponsible < firstResponsible" << std::endl;
@@ -41,31 +279,179 @@ std::optional<Data> process_input_and_load_graph_from_stream(
     }
     size_t nLocalResponsible = lastResponsibleGlobalIdx - firstResponsibleGlobalIdx + 1;
 
+    const char *edgesBegin = lineEnd == file.end() ? lineEnd : lineEnd + 1;
+
     try {
         Data data(firstResponsibleGlobalIdx, nLocalResponsible, nVerticesGlobal);
 
+        // two passes over the mapped text: count degrees, then fill the exactly sized CSR arrays
         // the graph considered is assumed to be undirected!
-        long long u, v, weight;
-        while (std::getline(instream, line)) {
-            if (line.empty()) continue;
-            std::istringstream iss_edge(line);
-            if (!(iss_edge >> u >> v >> weight)) {
-                std::cerr << "Rank " << myRank << ": Fail parse edge" << std::endl;
-                return {};
+        for (int pass = 0; pass < 2; ++pass) {
+            if (pass == 1) {
+                data.allocateAdjacency();
             }
-            if (u < 0 || v < 0 || weight < 0) {
-                std::cerr << "Rank " << myRank << ": Fail parse edge" << std::endl;
-                return {};
+            for (p = edgesBegin; p < file.end(); p = lineEnd + 1) {
+                lineEnd = lineEndOf(p, file.end());
+                if (lineEnd == p) {
+                    continue;
+                }
+                long long fields[3];
+                if (!parseFields(p, lineEnd, fields, 3) || fields[0] < 0 || fields[1] < 0 || fields[2] < 0) {
+                    std::cerr << "Rank " << myRank << ": Fail parse edge" << std::endl;
+                    return {};
+                }
+                if (pass == 0) {
+                    data.countEdge(fields[0], fields[1]);
+                } else {
+                    data.addEdgeFast(fields[0], fields[1], fields[2]);
+                }
             }
-            data.addEdgeFast(u, v, weight);
-        }
-        if (!assume_nomultiedge) {
-            data.trimMultiEdges();
         }
+        data.finalizeAdjacency(!assume_nomultiedge);
 
         return data;
     } catch (InvalidData& ex) {
         std::cerr << "Failed to parse infile: " << ex.what() << std::endl;
         return {};
     }
-}
\ No newline at end of file
+}
+
+std::optional<Data> load_graph500_edges(
+    int myRank,
+    const std::string& edges_folder,
+    int scale,
+    bool assume_nomultiedge
+) {
+    if (scale < 1 || scale > 40) {
+        if (myRank == 0) {
+            std::cerr << "Graph500 scale must be in [1, 40], got " << scale << std::endl;
+        }
+        return {};
+    }
+    int nProcessors;
+    MPI_Comm_size(MPI_COMM_WORLD, &nProcessors);
+    size_t nVerticesGlobal = 1ULL << scale;
+    uint64_t mask = nVerticesGlobal - 1;
+    BlockDistribution::Distribution dist(nProcessors, nVerticesGlobal);
+
+    std::string edgesPath = edges_folder + "/edges.out";
+    std::string weightsPath = edges_folder + "/edges.out.weights";
+    MPI_File edgesFile, weightsFile;
+    if (MPI_File_open(MPI_COMM_WORLD, edgesPath.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &edgesFile) != MPI_SUCCESS) {
+        std::cerr << "Rank " << myRank << ": Cannot open " << edgesPath << std::endl;
+        return {};
+    }
+    if (MPI_File_open(MPI_COMM_WORLD, weightsPath.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &weightsFile) != MPI_SUCCESS) {
+        std::cerr << "Rank " << myRank << ": Cannot open " << weightsPath << std::endl;
+        MPI_File_close(&edgesFile);
+        return {};
+    }
+    MPI_Offset edgesBytes, weightsBytes;
+    MPI_File_get_size(edgesFile, &edgesBytes);
+    MPI_File_get_size(weightsFile, &weightsBytes);
+    // like split.cpp, stop at the end of the shorter file
+    size_t nEdges = std::min(edgesBytes / GRAPH500_EDGE_BYTES, weightsBytes / GRAPH500_WEIGHT_BYTES);
+
+    // contiguous slice of the edge records per rank; all ranks run the same number of collective rounds
+    size_t sliceBegin = nEdges * myRank / nProcessors;
+    size_t sliceEnd = nEdges * (myRank + 1) / nProcessors;
+    size_t maxSlice = (nEdges + nProcessors - 1) / nProcessors;
+    size_t nRounds = (maxSlice + GRAPH500_EDGES_PER_ROUND - 1) / GRAPH500_EDGES_PER_ROUND;
+
+    std::optional<Data> result;
+    bool ok = true;
+    try {
+        Data data(*dist.getFirstGlobalIdxOf(myRank), *dist.getNResponsibleVertices(myRank), nVerticesGlobal);
+
+        std::vector<unsigned char> edgeBuf(std::min(maxSlice, GRAPH500_EDGES_PER_ROUND) * GRAPH500_EDGE_BYTES);
+        std::vector<unsigned char> weightBuf(std::min(maxSlice, GRAPH500_EDGES_PER_ROUND) * GRAPH500_WEIGHT_BYTES);
+        std::vector<int> sendCounts(nProcessors), sendDispls(nProcessors), recvCounts(nProcessors), recvDispls(nProcessors);
+        std::vector<InputEdge> sendBuf, recvBuf;
+        std::vector<int> owners;
+
+        // pass 0 reads and shuffles only the endpoints to count degrees, pass 1 the full edges into the
+        // exactly sized CSR arrays
+        for (int pass = 0; pass < 2; ++pass) {
+            if (pass == 1) {
+                data.allocateAdjacency();
+            }
+            for (size_t round = 0; round < nRounds; ++round) {
+                size_t first = std::min(sliceBegin + round * GRAPH500_EDGES_PER_ROUND, sliceEnd);
+                size_t count = std::min(GRAPH500_EDGES_PER_ROUND, sliceEnd - first);
+                ok = readRecordsAll(edgesFile, first, count, GRAPH500_EDGE_BYTES, edgeBuf.data()) && ok;
+                if (pass == 1) {
+                    ok = readRecordsAll(weightsFile, first, count, GRAPH500_WEIGHT_BYTES, weightBuf.data()) && ok;
+                }
+                if (!ok) {
+                    count = 0;
+                }
+
+                // an edge goes to the owner of each end, once if they coincide
+                std::fill(sendCounts.begin(), sendCounts.end(), 0);
+                owners.resize(2 * count);
+                for (size_t e = 0; e < count; ++e) {
+                    auto u = decodeGraph500Vertex(&edgeBuf[e * GRAPH500_EDGE_BYTES], mask);
+                    auto v = decodeGraph500Vertex(&edgeBuf[e * GRAPH500_EDGE_BYTES + 6], mask);
+                    owners[2 * e] = *dist.getResponsibleProcessor(u);
+                    owners[2 * e + 1] = *dist.getResponsibleProcessor(v);
+                    sendCounts[owners[2 * e]]++;
+                    if (owners[2 * e + 1] != owners[2 * e]) {
+                        sendCounts[owners[2 * e + 1]]++;
+                    }
+                }
+                int nSend = 0;
+                for (int p = 0; p < nProcessors; ++p) {
+                    sendDispls[p] = nSend;
+                    nSend += sendCounts[p];
+                }
+                sendBuf.resize(nSend);
+                auto fill = sendDispls;
+                for (size_t e = 0; e < count; ++e) {
+                    InputEdge edge{
+                        static_cast<long long>(decodeGraph500Vertex(&edgeBuf[e * GRAPH500_EDGE_BYTES], mask)),
+                        static_cast<long long>(decodeGraph500Vertex(&edgeBuf[e * GRAPH500_EDGE_BYTES + 6], mask)),
+                        pass == 1 ? decodeGraph500Weight(&weightBuf[e * GRAPH500_WEIGHT_BYTES]) : 0};
+                    sendBuf[fill[owners[2 * e]]++] = edge;
+                    if (owners[2 * e + 1] != owners[2 * e]) {
+                        sendBuf[fill[owners[2 * e + 1]]++] = edge;
+                    }
+                }
+
+                // counts and displacements in long longs: three per edge
+                MPI_CALL(MPI_Alltoall(sendCounts.data(), 1, MPI_INT, recvCounts.data(), 1, MPI_INT, MPI_COMM_WORLD));
+                int nRecv = 0;
+                for (int p = 0; p < nProcessors; ++p) {
+                    recvDispls[p] = 3 * nRecv;
+                    nRecv += recvCounts[p];
+                    recvCounts[p] *= 3;
+                    sendCounts[p] *= 3;
+                    sendDispls[p] *= 3;
+                }
+                recvBuf.resize(nRecv);
+                MPI_CALL(MPI_Alltoallv(sendBuf.data(), sendCounts.data(), sendDispls.data(), MPI_LONG_LONG,
+                                       recvBuf.data(), recvCounts.data(), recvDispls.data(), MPI_LONG_LONG, MPI_COMM_WORLD));
+
+                // the graph considered is assumed to be undirected!
+                for (const auto& edge : recvBuf) {
+                    if (pass == 0) {
+                        data.countEdge(edge.u, edge.v);
+                    } else {
+                        data.addEdgeFast(edge.u, edge.v, edge.weight);
+                    }
+                }
+            }
+        }
+
+        if (!ok) {
+            std::cerr << "Rank " << myRank << ": Fail read Graph500 edges" << std::endl;
+        } else {
+            data.finalizeAdjacency(!assume_nomultiedge);
+            result.emplace(std::move(data));
+        }
+    } catch (InvalidData& ex) {
+        std::cerr << "Failed to load Graph500 edges: " << ex.what() << std::endl;
+    }
+    MPI_File_close(&weightsFile);
+    MPI_File_close(&edgesFile);
+    return result;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <optional>
@@ -8,11 +9,13 @@
 #include <sstream>
 #include <stdexcept>
 #include <cstring>    // std::memcpy
-#include <functional> // std::function
 #include <limits>
 #include <iostream>
+#include <algorithm>
+#include <numeric>
 
 #include "logger.hpp"
+#include "ghost_cache.hpp"
 
 
 const long long INF = std::numeric_limits<long long>::max();
@@ -23,126 +26,1316 @@ public:
     InvalidData(const std::string &what) : std::runtime_error(what) {}
 };
 
+/// @brief `n` as an MPI count or displacement
+/// @throws InvalidData if it does not fit an `int`
+inline int mpiCount(size_t n)
+{
+    if (n > static_cast<size_t>(std::numeric_limits<int>::max()))
+    {
+        throw InvalidData("MPI count " + std::to_string(n) + " exceeds INT_MAX");
+    }
+    return static_cast<int>(n);
+}
+
+/// @brief How remote relaxations reach the owner of the target vertex.
+/// `Window`: one `MPI_Accumulate(MPI_MIN)` per relaxation, issued immediately.
+/// `Alltoallv`: relaxations are packed into one buffer per owner and exchanged in bulk at the end of the phase.
+enum class CommMode
+{
+    Window,
+    Alltoallv
+};
+
+/// @brief A single buffered relaxation: new candidate distance for the vertex with given index at its owner.
+struct RelaxMessage
+{
+    long long indexAtOwner;
+    long long newDist;
+};
+static_assert(sizeof(RelaxMessage) == 2 * sizeof(long long), "RelaxMessage is sent as pairs of MPI_LONG_LONG");
+
+/// @brief A vertex resolved to (owner rank, index at owner), packed into one word:
+/// the top 24 bits hold the owner, the low 40 bits the index. Resolving once at load time
+/// keeps the distribution arithmetic out of the relaxation loop.
+struct VertexRef
+{
+    static constexpr int OWNER_SHIFT = 40;
+    static constexpr uint64_t INDEX_MASK = (1ULL << OWNER_SHIFT) - 1;
+    static constexpr uint64_t MAX_OWNER = (1ULL << (64 - OWNER_SHIFT)) - 1;
+
+    uint64_t bits;
+
+    /// @throws InvalidData if either part does not fit its field (the all-ones word is kept free as a sentinel)
+    static VertexRef make(size_t ownerProcess, size_t indexAtOwner)
+    {
+        if (ownerProcess >= MAX_OWNER || indexAtOwner > INDEX_MASK)
+        {
+            throw InvalidData("Vertex reference out of encodable range: " + std::to_string(ownerProcess) + " " + std::to_string(indexAtOwner));
+        }
+        return VertexRef{(static_cast<uint64_t>(ownerProcess) << OWNER_SHIFT) | static_cast<uint64_t>(indexAtOwner)};
+    }
+
+    int owner() const
+    {
+        return static_cast<int>(bits >> OWNER_SHIFT);
+    }
+
+    MPI_Aint indexAtOwner() const
+    {
+        return static_cast<MPI_Aint>(bits & INDEX_MASK);
+    }
+};
+static_assert(sizeof(VertexRef) == sizeof(uint64_t), "VertexRef must stay one word");
+
+/// @brief Per-rank binary graph file: this header, then `uint64 offsets[nLocalResponsible + 1]`, `uint64 targets[nEdges]`
+/// and `int64 weights[nEdges]`, in native byte order. Edges of every vertex are sorted by weight and free of
+/// multi-edges. With `TARGETS_RESOLVED`, targets are `VertexRef` words for a block distribution over `nProcessors`;
+/// otherwise they are global vertex indices.
+struct BinaryGraphHeader
+{
+    static constexpr char MAGIC[8] = {'S', 'S', 'S', 'P', 'C', 'S', 'R', '\0'};
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t TARGETS_RESOLVED = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t nVerticesGlobal;
+    uint64_t firstResponsibleGlobalIdx;
+    uint64_t nLocalResponsible;
+    uint64_t nEdges;
+    uint64_t nProcessors;
+};
+static_assert(sizeof(BinaryGraphHeader) == 56, "BinaryGraphHeader layout is part of the file format");
+
 class Data
 {
+public:
+    struct Update
+    {
+        size_t vGlobalIdx;
+        long long prevDist;
+        long long newDist;
+    };
+
+private:
     size_t firstResponsibleGlobalIdx;
     size_t nLocalResponsible;
     size_t nVerticesGlobal;
 
-    /// @brief adj[local_idx] -> {global_neighbor_idx, weight}
-    std::vector<std::vector<std::pair<size_t, long long>>> neighOfLocal;
+    /// @brief adj[local_idx] -> {global_neighbor_idx, weight}. Only used while loading edges without a counting pass
+    /// (see `countEdge`); allocated by the first such `addEdgeFast` and released by `finalizeAdjacency`.
+    std::vector<std::vector<std::pair<size_t, long long>>> neighOfLocal;
+
+    /// @brief CSR adjacency: edges of local vertex `i` are at positions `[adjOffsets[i], adjOffsets[i + 1])`
+    /// of `adjTarget` and `adjWeight`. Until `resolveTargets` runs, `adjTarget[e].bits` is the global neighbour idx.
+    std::vector<size_t> adjOffsets;
+    std::vector<VertexRef> adjTarget;
+    std::vector<long long> adjWeight;
+    /// @brief Edges of every vertex are sorted by weight; `[adjOffsets[i], adjLightEnd[i])` are those lighter than `lightDelta`
+    std::vector<size_t> adjLightEnd;
+    long long lightDelta;
+    bool adjacencyFinalized;
+    bool targetsResolved;
+    /// @brief `allocateAdjacency` ran: `addEdgeFast` writes straight into the CSR arrays, `adjLightEnd[i]` being
+    /// the next free slot of vertex `i` until `finalizeAdjacency`
+    bool adjacencyAllocated;
+    size_t adjacencyBytesBefore;
+    size_t adjacencyBytesAfter;
+
+    /// @brief Sort `neighbors` by (target, weight) and compact it in place to the lightest edge per target
+    static void dedupeByTarget(std::vector<std::pair<size_t, long long>> &neighbors)
+    {
+        std::sort(neighbors.begin(), neighbors.end());
+        auto last = std::unique(neighbors.begin(), neighbors.end(), [](const auto &a, const auto &b)
+                                { return a.first == b.first; });
+        neighbors.erase(last, neighbors.end());
+    }
+
+    /// @returns false for self-loops, which are dropped
+    /// @throws InvalidData if an end is out of range or neither end is owned
+    bool acceptEdge(size_t u, size_t v, size_t weight) const
+    {
+        if (u == v)
+        {
+            return false;
+        }
+        if (u >= nVerticesGlobal || v >= nVerticesGlobal)
+        {
+            throw InvalidData(
+                std::string("Invalid edge data!") + std::to_string(u) + " " + std::to_string(v) + " " + std::to_string(weight));
+        }
+        if (!isOwned(u) && !isOwned(v))
+        {
+            throw InvalidData("Neither of edge ends owned!");
+        }
+        return true;
+    }
+
+    void placeEdge(size_t local, size_t target, long long weight)
+    {
+        if (!adjacencyAllocated)
+        {
+            neighOfLocal[local].push_back({target, weight});
+            return;
+        }
+        auto &next = adjLightEnd[local];
+        if (next == adjOffsets[local + 1])
+        {
+            throw InvalidData("More edges of vertex " + std::to_string(firstResponsibleGlobalIdx + local) + " than counted!");
+        }
+        adjTarget[next] = VertexRef{target};
+        adjWeight[next] = weight;
+        ++next;
+    }
+
+    /// @brief `finalizeAdjacency` after `allocateAdjacency`: sort (and trim) every vertex's slots and pack them
+    /// to the front. The arrays keep their counted size, so loading never holds two copies of the adjacency.
+    void finalizeAllocatedAdjacency(bool trimMultiEdges_)
+    {
+        for (size_t i = 0; i < nLocalResponsible; ++i)
+        {
+            if (adjLightEnd[i] != adjOffsets[i + 1])
+            {
+                throw InvalidData("Fewer edges of vertex " + std::to_string(firstResponsibleGlobalIdx + i) + " than counted!");
+            }
+        }
+
+        std::vector<std::pair<size_t, long long>> neighbors;
+        size_t pos = 0;
+        for (size_t i = 0; i < nLocalResponsible; ++i)
+        {
+            // slots of vertex i end where those of i + 1 begin; that offset is only rewritten in the next iteration
+            neighbors.clear();
+            for (auto e = adjOffsets[i]; e < adjOffsets[i + 1]; ++e)
+            {
+                neighbors.emplace_back(adjTarget[e].bits, adjWeight[e]);
+            }
+            if (trimMultiEdges_)
+            {
+                dedupeByTarget(neighbors);
+            }
+            std::sort(neighbors.begin(), neighbors.end(), [](const auto &a, const auto &b)
+                      { return a.second != b.second ? a.second < b.second : a.first < b.first; });
+            adjOffsets[i] = pos;
+            for (const auto &[target, weight] : neighbors)
+            {
+                adjTarget[pos] = VertexRef{target};
+                adjWeight[pos] = weight;
+                ++pos;
+            }
+        }
+        adjOffsets[nLocalResponsible] = pos;
+        adjTarget.resize(pos);
+        adjWeight.resize(pos);
+        adjLightEnd.assign(adjOffsets.begin() + 1, adjOffsets.end());
+        lightDelta = INF;
+
+        adjacencyBytesAfter = adjOffsets.capacity() * sizeof(size_t) + adjTarget.capacity() * sizeof(VertexRef) + adjWeight.capacity() * sizeof(long long) + adjLightEnd.capacity() * sizeof(size_t);
+        adjacencyFinalized = true;
+    }
+
+    /// @brief Convert a global id of a vertex to index of the corresponding field in the local `neighOfLocal` vector
+    /// @throws VertexOwnershipException if vertex is not owned
+    std::optional<size_t> globalToLocalIdx(size_t vGlobalIdx) const
+    {
+        if (!isOwned(vGlobalIdx))
+        {
+            return {};
+        }
+
+        return vGlobalIdx - firstResponsibleGlobalIdx;
+    }
+
+    // distToRoot[local_idx] for MPI_Win communication
+    std::vector<long long> distToRoot;
+
+    void *winMemory;
+    MPI_Win window;
+    int winDisp;
+    MPI_Aint winSize;
+
+    CommMode commMode;
+    int myRank;
+    int nProcessorsGlobal;
+    /// @brief outbox[ownerRank] -> relaxations waiting to be sent there (used in `CommMode::Alltoallv` or when coalescing)
+    std::vector<std::vector<RelaxMessage>> outbox;
+    /// @brief Keep only the best candidate per target vertex before the outbox leaves this process
+    bool coalesce;
+    unsigned long long nCoalesced;
+    /// @brief Best distance already sent to remote vertices; lets us drop relaxations that cannot improve them
+    GhostCache ghosts;
+    unsigned long long nGhostsRefreshed;
+    /// @brief Fences and all-to-all exchanges issued so far
+    unsigned long long nCollectives;
+    /// @brief Window memory equals `distToRoot`; cleared whenever either side may change
+    bool windowInSync;
+
+    /// @brief When set, the window is written only by this process (buffered relaxations), so we record which
+    /// entries changed and keep `window == distToRoot` between phases instead of scanning/copying all of it.
+    bool trackDirty;
+    std::vector<size_t> dirty;
+    std::vector<unsigned char> isDirty;
+
+    /// @brief Relaxation threads of this process. With more than one, every thread buffers into its own outbox
+    /// (`outbox` for thread 0, `threadOutboxes[t - 1]` for thread t) and the owner applies relaxations with atomic min.
+    int nThreads;
+    std::vector<std::vector<std::vector<RelaxMessage>>> threadOutboxes;
+    /// @brief dirty entries found by each thread, merged into `dirty` before updates are collected
+    std::vector<std::vector<size_t>> threadDirty;
+
+    /// @brief Distances of the processes on this node live in one `MPI_Win_allocate_shared` segment; relaxations
+    /// of their vertices are atomic-min stores into `peerDist[owner]` instead of messages.
+    bool sharedMemory;
+    MPI_Comm nodeComm;
+    MPI_Win nodeWindow;
+    /// @brief peerDist[worldRank] -> distance array of that process if it is on this node, else nullptr
+    std::vector<long long *> peerDist;
+    /// @brief per thread: relaxations stored directly into node-local memory
+    std::vector<unsigned long long> nSharedRelaxations;
+
+    /// @brief Pipelined relaxation: the relaxation loop hands over what it buffered after every `chunkSize` active
+    /// vertices (`flushChunk`, 0 = the whole active set is one chunk), so it travels while the next chunk is computed.
+    /// In alltoallv mode a chunk is one `MPI_Isend` per owner on `chunkComm`, tagged with the parity of the phase;
+    /// in window mode it is issued as `MPI_Accumulate`s. Either way `sending[i]` keeps a buffer alive until its
+    /// send completes (`sendRequests[i]`) or, for accumulates, until the closing fence.
+    size_t chunkSize;
+    MPI_Comm chunkComm;
+    int chunkTag;
+    std::vector<std::vector<RelaxMessage>> sending;
+    std::vector<MPI_Request> sendRequests;
+    /// @brief per process: chunks sent to it and received from it in the current phase
+    std::vector<int> chunksSentTo;
+    std::vector<int> chunksReceivedFrom;
+    std::vector<RelaxMessage> incoming;
+    unsigned long long nChunksSent;
+
+    /// @brief Make direct stores by processes on this node visible on both sides of a node barrier.
+    /// Separates the relaxation step from the local reads/writes of the window before and after it.
+    void nodeBarrier()
+    {
+        MPI_CALL(MPI_Win_sync(nodeWindow));
+        MPI_CALL(MPI_Barrier(nodeComm));
+        MPI_CALL(MPI_Win_sync(nodeWindow));
+        nCollectives++;
+    }
+
+    void markDirty(size_t localIdx)
+    {
+        if (trackDirty && !isDirty[localIdx])
+        {
+            isDirty[localIdx] = 1;
+            dirty.push_back(localIdx);
+        }
+    }
+
+    /// @brief `markDirty` that may run on several threads at once
+    void markDirtyConcurrent(size_t localIdx, int thread)
+    {
+        if (trackDirty && !__atomic_exchange_n(&isDirty[localIdx], 1, __ATOMIC_RELAXED))
+        {
+            threadDirty[thread].push_back(localIdx);
+        }
+    }
+
+    /// @brief Lower window entry `localIdx` to `dist`; see `atomicMin`
+    bool atomicMinToWin(size_t localIdx, long long dist)
+    {
+        return atomicMin(static_cast<long long *>(winMemory) + localIdx, dist);
+    }
+
+    /// @brief Lower `*slot` to `dist` with a compare-and-swap loop; safe against other threads or processes
+    /// (through shared memory) doing the same.
+    /// @returns true if the entry was lowered
+    static bool atomicMin(long long *slot, long long dist)
+    {
+        auto current = __atomic_load_n(slot, __ATOMIC_RELAXED);
+        while (dist < current)
+        {
+            if (__atomic_compare_exchange_n(slot, &current, dist, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// @brief Compare window entry `i` with `distToRoot[i]`, record an update if it decreased
+    void collectUpdate(size_t i, std::vector<Update> &updates)
+    {
+        auto new_dist = static_cast<long long *>(winMemory)[i];
+        if (new_dist > distToRoot[i])
+        {
+            // throw InvalidData("MPI distance relax caused dist to increase!");
+            return;
+        }
+        else if (new_dist < distToRoot[i])
+        {
+            Update update;
+            update.vGlobalIdx = getFirstResponsibleGlobalIdx() + i;
+            update.prevDist = distToRoot[i];
+            update.newDist = new_dist;
+            updates.push_back(update);
+            distToRoot[i] = new_dist;
+        }
+    }
+
+    bool buffersRelaxations() const
+    {
+        return commMode == CommMode::Alltoallv || coalesce || nThreads > 1;
+    }
+
+    /// @brief Append every thread's buffered relaxations to `outbox`
+    void mergeThreadOutboxes()
+    {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (int p = 0; p < nProcessorsGlobal; ++p)
+        {
+            for (auto &box : threadOutboxes)
+            {
+                outbox[p].insert(outbox[p].end(), box[p].begin(), box[p].end());
+                box[p].clear();
+            }
+        }
+    }
+
+    /// @brief Sort every per-owner buffer by target and drop all but the smallest distance for each target.
+    void coalesceOutbox()
+    {
+        for (auto &msgs : outbox)
+        {
+            if (msgs.size() < 2)
+            {
+                continue;
+            }
+            std::sort(msgs.begin(), msgs.end(), [](const RelaxMessage &a, const RelaxMessage &b)
+                      { return a.indexAtOwner < b.indexAtOwner || (a.indexAtOwner == b.indexAtOwner && a.newDist < b.newDist); });
+            auto last = std::unique(msgs.begin(), msgs.end(), [](const RelaxMessage &a, const RelaxMessage &b)
+                                    { return a.indexAtOwner == b.indexAtOwner; });
+            nCoalesced += std::distance(last, msgs.end());
+            msgs.erase(last, msgs.end());
+        }
+    }
+
+    /// @brief Issue the buffered relaxations as `MPI_Accumulate`s. Must be called inside an access epoch;
+    /// the buffers are only released after the closing fence.
+    void accumulateOutbox()
+    {
+        for (int p = 0; p < nProcessorsGlobal; ++p)
+        {
+            for (const auto &msg : outbox[p])
+            {
+                MPI_CALL(MPI_Accumulate(
+                    &msg.newDist, 1, MPI_LONG_LONG,
+                    p, msg.indexAtOwner, 1, MPI_LONG_LONG,
+                    MPI_MIN, window));
+            }
+        }
+    }
+
+    /// @brief Apply a relaxation received from any process (including self) to the window memory.
+    void applyRelaxToWin(const RelaxMessage &msg)
+    {
+        auto *winDist = static_cast<long long *>(winMemory);
+        if (msg.indexAtOwner < 0 || static_cast<size_t>(msg.indexAtOwner) >= nLocalResponsible)
+        {
+            throw InvalidData("Received relaxation of vertex not owned!");
+        }
+        if (msg.newDist < winDist[msg.indexAtOwner])
+        {
+            winDist[msg.indexAtOwner] = msg.newDist;
+            markDirty(msg.indexAtOwner);
+        }
+    }
+
+    void exchangeOutbox()
+    {
+        std::vector<int> sendCounts(nProcessorsGlobal), recvCounts(nProcessorsGlobal);
+        std::vector<int> sendDispls(nProcessorsGlobal), recvDispls(nProcessorsGlobal);
+        for (int p = 0; p < nProcessorsGlobal; ++p)
+        {
+            sendCounts[p] = mpiCount(outbox[p].size() * 2);
+        }
+        MPI_CALL(MPI_Alltoall(sendCounts.data(), 1, MPI_INT, recvCounts.data(), 1, MPI_INT, MPI_COMM_WORLD));
+        nCollectives++;
+
+        size_t totalSend = 0, totalRecv = 0;
+        for (int p = 0; p < nProcessorsGlobal; ++p)
+        {
+            sendDispls[p] = mpiCount(totalSend);
+            recvDispls[p] = mpiCount(totalRecv);
+            totalSend += sendCounts[p];
+            totalRecv += recvCounts[p];
+        }
+
+        std::vector<RelaxMessage> sendBuf;
+        sendBuf.reserve(totalSend / 2);
+        for (auto &msgs : outbox)
+        {
+            sendBuf.insert(sendBuf.end(), msgs.begin(), msgs.end());
+            msgs.clear();
+        }
+        std::vector<RelaxMessage> recvBuf(totalRecv / 2);
+
+        MPI_CALL(MPI_Alltoallv(
+            sendBuf.data(), sendCounts.data(), sendDispls.data(), MPI_LONG_LONG,
+            recvBuf.data(), recvCounts.data(), recvDispls.data(), MPI_LONG_LONG,
+            MPI_COMM_WORLD));
+        nCollectives++;
+
+        if (nThreads > 1)
+        {
+            applyRelaxationsConcurrently(recvBuf);
+            return;
+        }
+        for (const auto &msg : recvBuf)
+        {
+            applyRelaxToWin(msg);
+        }
+    }
+
+    /// @brief `applyRelaxToWin` for all of `msgs`, split among the relaxation threads
+    void applyRelaxationsConcurrently(const std::vector<RelaxMessage> &msgs)
+    {
+        bool invalid = false;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) reduction(|| : invalid)
+#endif
+        for (size_t m = 0; m < msgs.size(); ++m)
+        {
+            auto idx = msgs[m].indexAtOwner;
+            if (idx < 0 || static_cast<size_t>(idx) >= nLocalResponsible)
+            {
+                invalid = true;
+                continue;
+            }
+            if (atomicMinToWin(idx, msgs[m].newDist))
+            {
+                markDirtyConcurrent(idx, currentThread());
+            }
+        }
+        if (invalid)
+        {
+            throw InvalidData("Received relaxation of vertex not owned!");
+        }
+    }
+
+    /// @brief Lower window entries to the relaxations of a chunk that arrived while others may still be storing
+    /// into the window (node peers, with shared memory)
+    void applyChunk(const std::vector<RelaxMessage> &msgs)
+    {
+        for (const auto &msg : msgs)
+        {
+            if (msg.indexAtOwner < 0 || static_cast<size_t>(msg.indexAtOwner) >= nLocalResponsible)
+            {
+                throw InvalidData("Received relaxation of vertex not owned!");
+            }
+            if (atomicMinToWin(msg.indexAtOwner, msg.newDist))
+            {
+                markDirty(msg.indexAtOwner);
+            }
+        }
+    }
+
+    void receiveChunk(const MPI_Status &status)
+    {
+        int count = 0;
+        MPI_CALL(MPI_Get_count(&status, MPI_LONG_LONG, &count));
+        incoming.resize(count / 2);
+        MPI_CALL(MPI_Recv(incoming.data(), count, MPI_LONG_LONG, status.MPI_SOURCE, chunkTag, chunkComm, MPI_STATUS_IGNORE));
+        chunksReceivedFrom[status.MPI_SOURCE]++;
+        applyChunk(incoming);
+    }
+
+    /// @brief Send the buffered relaxations as one chunk: `MPI_Accumulate`s in window mode, else an `MPI_Isend` per
+    /// owner (own relaxations are applied right away)
+    /// @returns number of per-owner chunks sent
+    unsigned long long sendOutboxChunk()
+    {
+        unsigned long long nSent = 0;
+        if (commMode == CommMode::Window)
+        {
+            accumulateOutbox();
+        }
+        for (int p = 0; p < nProcessorsGlobal; ++p)
+        {
+            if (outbox[p].empty())
+            {
+                continue;
+            }
+            if (commMode != CommMode::Window && p == myRank)
+            {
+                applyChunk(outbox[p]);
+                outbox[p].clear();
+                continue;
+            }
+            sending.push_back(std::move(outbox[p]));
+            outbox[p].clear();
+            nSent++;
+            if (commMode == CommMode::Window)
+            {
+                continue;
+            }
+            sendRequests.push_back(MPI_REQUEST_NULL);
+            const auto &buffer = sending.back();
+            MPI_CALL(MPI_Isend(buffer.data(), static_cast<int>(2 * buffer.size()), MPI_LONG_LONG, p, chunkTag, chunkComm,
+                               &sendRequests.back()));
+            chunksSentTo[p]++;
+        }
+        return nSent;
+    }
+
+    /// @brief Apply every chunk that has already arrived
+    void drainChunks()
+    {
+        while (true)
+        {
+            int arrived = 0;
+            MPI_Status status;
+            MPI_CALL(MPI_Iprobe(MPI_ANY_SOURCE, chunkTag, chunkComm, &arrived, &status));
+            if (!arrived)
+            {
+                return;
+            }
+            receiveChunk(status);
+        }
+    }
+
+    /// @brief Alltoallv mode end of a pipelined phase: tell every process how many chunks it gets, receive the
+    /// missing ones and wait for our sends. Chunks from one sender arrive in order and carry the phase parity, so
+    /// a process that is already a phase ahead cannot be mistaken for a late one.
+    void finishChunks()
+    {
+        sendOutboxChunk();
+        std::vector<int> expected(nProcessorsGlobal);
+        MPI_CALL(MPI_Alltoall(chunksSentTo.data(), 1, MPI_INT, expected.data(), 1, MPI_INT, chunkComm));
+        nCollectives++;
+        for (int p = 0; p < nProcessorsGlobal; ++p)
+        {
+            while (chunksReceivedFrom[p] < expected[p])
+            {
+                MPI_Status status;
+                MPI_CALL(MPI_Probe(p, chunkTag, chunkComm, &status));
+                receiveChunk(status);
+            }
+        }
+        MPI_CALL(MPI_Waitall(static_cast<int>(sendRequests.size()), sendRequests.data(), MPI_STATUSES_IGNORE));
+        sendRequests.clear();
+        sending.clear();
+        std::fill(chunksSentTo.begin(), chunksSentTo.end(), 0);
+        std::fill(chunksReceivedFrom.begin(), chunksReceivedFrom.end(), 0);
+        chunkTag ^= 1;
+    }
+
+public:
+    std::vector<Update> selfUpdates;
+
+    Data(size_t firstResponsibleGlobalIdx_, size_t nLocalResponsible_, size_t nVerticesGlobal_)
+        : firstResponsibleGlobalIdx(firstResponsibleGlobalIdx_),
+          nLocalResponsible(nLocalResponsible_),
+          nVerticesGlobal(nVerticesGlobal_),
+          neighOfLocal(),
+          adjOffsets(),
+          adjTarget(),
+          adjWeight(),
+          adjLightEnd(),
+          lightDelta(0),
+          adjacencyFinalized(false),
+          targetsResolved(false),
+          adjacencyAllocated(false),
+          adjacencyBytesBefore(0),
+          adjacencyBytesAfter(0),
+          distToRoot(nLocalResponsible_, INF),
+          winMemory(nullptr),
+          window(MPI_WIN_NULL),
+          winDisp(sizeof(long long)),
+          winSize(nLocalResponsible_ * sizeof(long long)),
+          commMode(CommMode::Window),
+          myRank(0),
+          nProcessorsGlobal(0),
+          outbox(),
+          coalesce(false),
+          nCoalesced(0),
+          ghosts(),
+          nGhostsRefreshed(0),
+          nCollectives(0),
+          windowInSync(false),
+          trackDirty(false),
+          dirty(),
+          isDirty(),
+          nThreads(1),
+          threadOutboxes(),
+          threadDirty(1),
+          sharedMemory(false),
+          nodeComm(MPI_COMM_NULL),
+          nodeWindow(MPI_WIN_NULL),
+          peerDist(),
+          nSharedRelaxations(1, 0),
+          chunkSize(0),
+          chunkComm(MPI_COMM_NULL),
+          chunkTag(0),
+          sending(),
+          sendRequests(),
+          chunksSentTo(),
+          chunksReceivedFrom(),
+          incoming(),
+          nChunksSent(0),
+          selfUpdates()
+    {
+        if (nVerticesGlobal == 0 || lastResponsibleGlobalIdx() < firstResponsibleGlobalIdx || lastResponsibleGlobalIdx() >= nVerticesGlobal || distToRoot.size() != nLocalResponsible || distToRoot[0] != INF)
+        {
+            throw InvalidData(
+                std::string("Input data invalid! ") + std::to_string(firstResponsibleGlobalIdx) + " " + std::to_string(nLocalResponsible) + " " + std::to_string(nVerticesGlobal) + " " + std::to_string(lastResponsibleGlobalIdx()) + " " + std::to_string(distToRoot.size()) + " " + std::to_string(distToRoot[0]));
+        }
+
+        int mpi_err = MPI_Win_allocate(
+            winSize, winDisp,
+            MPI_INFO_NULL, MPI_COMM_WORLD, &winMemory, &window);
+
+        if (mpi_err != MPI_SUCCESS || window == MPI_WIN_NULL)
+        {
+            throw InvalidData("MPI_Win_allocate failed!");
+        }
+
+        MPI_CALL(MPI_Comm_rank(MPI_COMM_WORLD, &myRank));
+        MPI_CALL(MPI_Comm_size(MPI_COMM_WORLD, &nProcessorsGlobal));
+        outbox.resize(nProcessorsGlobal);
+    }
+
+    void freeWindow()
+    {
+        MPI_Win_free(&window);
+        if (sharedMemory)
+        {
+            // `window` was created over the shared segment, so it goes first
+            MPI_Win_unlock_all(nodeWindow);
+            MPI_Win_free(&nodeWindow);
+            MPI_Comm_free(&nodeComm);
+        }
+        if (chunkComm != MPI_COMM_NULL)
+        {
+            MPI_Comm_free(&chunkComm);
+        }
+    }
+
+    // delete copy constructor and assignment
+    Data(const Data &) = delete;
+    Data &operator=(const Data &) = delete;
+    Data &operator=(Data &&) = delete;
+
+    // allow move constructor
+    Data(Data &&other) noexcept
+        : firstResponsibleGlobalIdx(other.firstResponsibleGlobalIdx),
+          nLocalResponsible(other.nLocalResponsible),
+          nVerticesGlobal(other.nVerticesGlobal),
+          neighOfLocal(std::move(other.neighOfLocal)),
+          adjOffsets(std::move(other.adjOffsets)),
+          adjTarget(std::move(other.adjTarget)),
+          adjWeight(std::move(other.adjWeight)),
+          adjLightEnd(std::move(other.adjLightEnd)),
+          lightDelta(other.lightDelta),
+          adjacencyFinalized(other.adjacencyFinalized),
+          targetsResolved(other.targetsResolved),
+          adjacencyAllocated(other.adjacencyAllocated),
+          adjacencyBytesBefore(other.adjacencyBytesBefore),
+          adjacencyBytesAfter(other.adjacencyBytesAfter),
+          distToRoot(std::move(other.distToRoot)),
+          winMemory(other.winMemory),
+          window(other.window),
+          winDisp(other.winDisp),
+          winSize(other.winSize),
+          commMode(other.commMode),
+          myRank(other.myRank),
+          nProcessorsGlobal(other.nProcessorsGlobal),
+          outbox(std::move(other.outbox)),
+          coalesce(other.coalesce),
+          nCoalesced(other.nCoalesced),
+          ghosts(std::move(other.ghosts)),
+          nGhostsRefreshed(other.nGhostsRefreshed),
+          nCollectives(other.nCollectives),
+          windowInSync(other.windowInSync),
+          trackDirty(other.trackDirty),
+          dirty(std::move(other.dirty)),
+          isDirty(std::move(other.isDirty)),
+          nThreads(other.nThreads),
+          threadOutboxes(std::move(other.threadOutboxes)),
+          threadDirty(std::move(other.threadDirty)),
+          sharedMemory(other.sharedMemory),
+          nodeComm(other.nodeComm),
+          nodeWindow(other.nodeWindow),
+          peerDist(std::move(other.peerDist)),
+          nSharedRelaxations(std::move(other.nSharedRelaxations)),
+          chunkSize(other.chunkSize),
+          chunkComm(other.chunkComm),
+          chunkTag(other.chunkTag),
+          sending(std::move(other.sending)),
+          sendRequests(std::move(other.sendRequests)),
+          chunksSentTo(std::move(other.chunksSentTo)),
+          chunksReceivedFrom(std::move(other.chunksReceivedFrom)),
+          incoming(std::move(other.incoming)),
+          nChunksSent(other.nChunksSent),
+          selfUpdates(std::move(other.selfUpdates))
+    {
+        other.window = MPI_WIN_NULL;
+        other.winMemory = nullptr;
+        other.nodeWindow = MPI_WIN_NULL;
+        other.nodeComm = MPI_COMM_NULL;
+        other.chunkComm = MPI_COMM_NULL;
+    }
+
+    /// @brief Move the per-vertex edge lists into the CSR arrays, sorted by weight (ties by target), and release them.
+    /// After `allocateAdjacency` the edges already are in the CSR arrays and are sorted (and trimmed) in place.
+    /// With `trimMultiEdges_`, parallel edges are reduced to the lightest one on the way, like `trimMultiEdges`.
+    /// Must be called once, after all edges were added.
+    void finalizeAdjacency(bool trimMultiEdges_ = false)
+    {
+        if (adjacencyFinalized)
+        {
+            throw InvalidData("Adjacency already finalized!");
+        }
+        if (adjacencyAllocated)
+        {
+            finalizeAllocatedAdjacency(trimMultiEdges_);
+            return;
+        }
+
+        neighOfLocal.resize(nLocalResponsible);
+        size_t nEdges = 0;
+        adjacencyBytesBefore = neighOfLocal.capacity() * sizeof(neighOfLocal[0]);
+        for (const auto &neighbors : neighOfLocal)
+        {
+            nEdges += neighbors.size();
+            adjacencyBytesBefore += neighbors.capacity() * sizeof(neighbors[0]);
+        }
+
+        if (trimMultiEdges_)
+        {
+            // dedupe first so the CSR arrays get their exact final size
+            nEdges = 0;
+            for (auto &neighbors : neighOfLocal)
+            {
+                dedupeByTarget(neighbors);
+                nEdges += neighbors.size();
+            }
+        }
+        adjOffsets.resize(nLocalResponsible + 1);
+        adjTarget.resize(nEdges);
+        adjWeight.resize(nEdges);
+        size_t pos = 0;
+        for (size_t i = 0; i < nLocalResponsible; ++i)
+        {
+            adjOffsets[i] = pos;
+            std::sort(neighOfLocal[i].begin(), neighOfLocal[i].end(), [](const auto &a, const auto &b)
+                      { return a.second != b.second ? a.second < b.second : a.first < b.first; });
+            for (const auto &[target, weight] : neighOfLocal[i])
+            {
+                adjTarget[pos] = VertexRef{target};
+                adjWeight[pos] = weight;
+                ++pos;
+            }
+            // free as we go, so that peak memory is not both layouts at once
+            std::vector<std::pair<size_t, long long>>().swap(neighOfLocal[i]);
+        }
+        adjOffsets[nLocalResponsible] = pos;
+        std::vector<std::vector<std::pair<size_t, long long>>>().swap(neighOfLocal);
+        adjLightEnd.assign(adjOffsets.begin() + 1, adjOffsets.end());
+        lightDelta = INF;
+
+        adjacencyBytesAfter = adjOffsets.capacity() * sizeof(size_t) + adjTarget.capacity() * sizeof(VertexRef) + adjWeight.capacity() * sizeof(long long) + adjLightEnd.capacity() * sizeof(size_t);
+        adjacencyFinalized = true;
+    }
+
+    /// @brief Take a complete CSR adjacency (as stored in a `BinaryGraphHeader` file) instead of building it from edges.
+    /// With `resolved`, targets are `VertexRef` words for `nProcessors` processes and `resolveTargets` must not be called.
+    /// @throws InvalidData if the arrays are inconsistent with each other or with this process's vertices
+    void adoptAdjacency(std::vector<size_t> &&offsets, std::vector<VertexRef> &&targets, std::vector<long long> &&weights,
+                        bool resolved, size_t nProcessors)
+    {
+        if (adjacencyFinalized)
+        {
+            throw InvalidData("Adjacency already finalized!");
+        }
+        if (offsets.size() != nLocalResponsible + 1 || offsets.front() != 0 || offsets.back() != targets.size() || weights.size() != targets.size())
+        {
+            throw InvalidData("Binary graph: CSR arrays do not match the header!");
+        }
+        for (size_t i = 0; i < nLocalResponsible; ++i)
+        {
+            if (offsets[i] > offsets[i + 1] || !std::is_sorted(weights.begin() + offsets[i], weights.begin() + offsets[i + 1]))
+            {
+                throw InvalidData("Binary graph: edges of vertex " + std::to_string(firstResponsibleGlobalIdx + i) + " are not a sorted range!");
+            }
+            // sorted, so the first weight is the smallest
+            if (offsets[i] < offsets[i + 1] && weights[offsets[i]] < 0)
+            {
+                throw InvalidData("Binary graph: negative weight!");
+            }
+        }
+        for (auto target : targets)
+        {
+            if (resolved ? static_cast<size_t>(target.owner()) >= nProcessors : target.bits >= nVerticesGlobal)
+            {
+                throw InvalidData("Binary graph: edge target out of range!");
+            }
+        }
+
+        std::vector<std::vector<std::pair<size_t, long long>>>().swap(neighOfLocal);
+        adjOffsets = std::move(offsets);
+        adjTarget = std::move(targets);
+        adjWeight = std::move(weights);
+        adjLightEnd.assign(adjOffsets.begin() + 1, adjOffsets.end());
+        lightDelta = INF;
+        adjacencyBytesAfter = adjOffsets.capacity() * sizeof(size_t) + adjTarget.capacity() * sizeof(VertexRef) + adjWeight.capacity() * sizeof(long long) + adjLightEnd.capacity() * sizeof(size_t);
+        adjacencyBytesBefore = adjacencyBytesAfter;
+        adjacencyFinalized = true;
+        targetsResolved = resolved;
+    }
+
+    bool hasResolvedTargets() const
+    {
+        return targetsResolved;
+    }
+
+    /// @brief Raw CSR arrays, for writing them out (see `BinaryGraphHeader`)
+    const std::vector<size_t> &getAdjOffsets() const
+    {
+        return adjOffsets;
+    }
+
+    const std::vector<VertexRef> &getAdjTargets() const
+    {
+        return adjTarget;
+    }
+
+    const std::vector<long long> &getAdjWeights() const
+    {
+        return adjWeight;
+    }
+
+    /// @brief Rewrite every CSR target from its global idx to (owner, index at owner), in place.
+    /// `Distribution` is anything answering `getResponsibleProcessor` and `globalToLocal` with an optional,
+    /// so the relaxation loop does not depend on how vertices are distributed.
+    /// @throws InvalidData if a target has no owner
+    template <typename Distribution>
+    void resolveTargets(const Distribution &dist)
+    {
+        if (!adjacencyFinalized || targetsResolved)
+        {
+            throw InvalidData("Targets can only be resolved once, after finalizing adjacency!");
+        }
+        for (auto &target : adjTarget)
+        {
+            auto ownerOpt = dist.getResponsibleProcessor(target.bits);
+            auto indexAtOwnerOpt = dist.globalToLocal(target.bits);
+            if (!ownerOpt.has_value() || !indexAtOwnerOpt.has_value())
+            {
+                throw InvalidData("Owner of vertex " + std::to_string(target.bits) + " doesn't exist!");
+            }
+            target = VertexRef::make(*ownerOpt, *indexAtOwnerOpt);
+        }
+        targetsResolved = true;
+    }
+
+    /// @brief Recompute, for every vertex, where its light edges (`weight < delta`) end. O(V log deg); no-op if `delta` is unchanged.
+    void splitByWeight(long long delta)
+    {
+        if (delta == lightDelta)
+        {
+            return;
+        }
+        for (size_t i = 0; i < nLocalResponsible; ++i)
+        {
+            adjLightEnd[i] = std::lower_bound(adjWeight.begin() + adjOffsets[i], adjWeight.begin() + adjOffsets[i + 1], delta) - adjWeight.begin();
+        }
+        lightDelta = delta;
+    }
+
+    /// @brief CSR edge range `[first, last)` of an owned vertex
+    std::pair<size_t, size_t> edgeRange(size_t vGlobalIdx) const
+    {
+        auto locOpt = globalToLocalIdx(vGlobalIdx);
+        if (!locOpt.has_value())
+        {
+            throw InvalidData("Vertex not owned!");
+        }
+        return {adjOffsets[*locOpt], adjOffsets[*locOpt + 1]};
+    }
+
+    /// @brief First CSR edge of an owned vertex with `weight >= threshold`. Only the light prefix is searched when `threshold <= lightDelta`.
+    size_t firstEdgeNotLighter(size_t vGlobalIdx, long long threshold) const
+    {
+        auto locOpt = globalToLocalIdx(vGlobalIdx);
+        if (!locOpt.has_value())
+        {
+            throw InvalidData("Vertex not owned!");
+        }
+        auto first = adjOffsets[*locOpt];
+        auto last = threshold <= lightDelta ? adjLightEnd[*locOpt] : adjOffsets[*locOpt + 1];
+        if (threshold == lightDelta)
+        {
+            return last;
+        }
+        return std::lower_bound(adjWeight.begin() + first, adjWeight.begin() + last, threshold) - adjWeight.begin();
+    }
+
+    /// @brief Bytes taken by the adjacency while loading (per-vertex lists, or the counted CSR arrays after
+    /// `allocateAdjacency`) and after `finalizeAdjacency` (containers' payload, not allocator overhead)
+    size_t getAdjacencyBytesBefore() const
+    {
+        return adjacencyBytesBefore;
+    }
 
-    /// @brief Convert a global id of a vertex to index of the corresponding field in the local `neighOfLocal` vector
-    /// @throws VertexOwnershipException if vertex is not owned
-    std::optional<size_t> globalToLocalIdx(size_t vGlobalIdx) const
+    size_t getAdjacencyBytesAfter() const
     {
-        if (!isOwned(vGlobalIdx))
+        return adjacencyBytesAfter;
+    }
+
+    size_t getNLocalEdges() const
+    {
+        return adjTarget.size();
+    }
+
+    void syncWindowToActual()
+    {
+        if (trackDirty || windowInSync)
         {
-            return {};
+            // window already equals distToRoot: dirty tracking keeps them in step (see `getUpdatesAndSyncDataToWin`)
+            // or nothing changed since the last copy
+            return;
         }
+        std::memcpy(winMemory, distToRoot.data(), winSize);
+        windowInSync = true;
+    }
 
-        return vGlobalIdx - firstResponsibleGlobalIdx;
+    /// @brief Detect updates from the entries written during the phase instead of scanning the whole window.
+    /// Only valid when nobody else writes into our window, i.e. with `CommMode::Alltoallv`.
+    /// @throws InvalidData in window mode
+    void setDirtyTracking(bool enable)
+    {
+        if (enable && (commMode == CommMode::Window || sharedMemory))
+        {
+            throw InvalidData("Dirty tracking needs relaxations applied by the owner (--comm alltoallv, no shared memory)!");
+        }
+        trackDirty = false;
+        syncWindowToActual();
+        trackDirty = enable;
+        isDirty.assign(enable ? nLocalResponsible : 0, 0);
+        dirty.clear();
     }
 
-    // distToRoot[local_idx] for MPI_Win communication
-    std::vector<long long> distToRoot;
+    void setCommMode(CommMode mode)
+    {
+        commMode = mode;
+    }
 
-    void *winMemory;
-    MPI_Win window;
-    int winDisp;
-    MPI_Aint winSize;
+    CommMode getCommMode() const
+    {
+        return commMode;
+    }
 
-public:
-    struct Update
+    /// @brief Back the distance window with memory shared by all processes on this node. Collective over all processes.
+    /// Processes on the same node then relax each other's vertices with atomic-min stores; only relaxations to other
+    /// nodes are exchanged. Needs owner-applied relaxations (`CommMode::Alltoallv`): a store racing an
+    /// `MPI_Accumulate` on the same entry would not be atomic. Others write our window, so no dirty tracking either.
+    /// @throws InvalidData
+    void enableSharedMemory()
     {
-        size_t vGlobalIdx;
-        long long prevDist;
-        long long newDist;
-    };
-    std::vector<Update> selfUpdates;
+        if (commMode != CommMode::Alltoallv || trackDirty)
+        {
+            throw InvalidData("Shared-memory distances need --comm alltoallv and full update scans!");
+        }
+        if (sharedMemory)
+        {
+            return;
+        }
+        MPI_CALL(MPI_Win_free(&window));
+        MPI_CALL(MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, myRank, MPI_INFO_NULL, &nodeComm));
+        MPI_CALL(MPI_Win_allocate_shared(winSize, winDisp, MPI_INFO_NULL, nodeComm, &winMemory, &nodeWindow));
+        // remote nodes (and ghost refreshes) still reach the same memory through a world window
+        MPI_CALL(MPI_Win_create(winMemory, winSize, winDisp, MPI_INFO_NULL, MPI_COMM_WORLD, &window));
+        MPI_CALL(MPI_Win_lock_all(MPI_MODE_NOCHECK, nodeWindow));
+        sharedMemory = true;
 
-    Data(size_t firstResponsibleGlobalIdx_, size_t nLocalResponsible_, size_t nVerticesGlobal_)
-        : firstResponsibleGlobalIdx(firstResponsibleGlobalIdx_),
-          nLocalResponsible(nLocalResponsible_),
-          nVerticesGlobal(nVerticesGlobal_),
-          neighOfLocal(nLocalResponsible_, std::vector<std::pair<size_t, long long>>()),
-          distToRoot(nLocalResponsible_, INF),
-          winMemory(nullptr),
-          window(MPI_WIN_NULL),
-          winDisp(sizeof(long long)),
-          winSize(nLocalResponsible_ * sizeof(long long)),
-          selfUpdates()
+        MPI_Group worldGroup, nodeGroup;
+        MPI_CALL(MPI_Comm_group(MPI_COMM_WORLD, &worldGroup));
+        MPI_CALL(MPI_Comm_group(nodeComm, &nodeGroup));
+        std::vector<int> worldRanks(nProcessorsGlobal), nodeRanks(nProcessorsGlobal);
+        for (int p = 0; p < nProcessorsGlobal; ++p)
+        {
+            worldRanks[p] = p;
+        }
+        MPI_CALL(MPI_Group_translate_ranks(worldGroup, nProcessorsGlobal, worldRanks.data(), nodeGroup, nodeRanks.data()));
+        MPI_Group_free(&worldGroup);
+        MPI_Group_free(&nodeGroup);
+
+        peerDist.assign(nProcessorsGlobal, nullptr);
+        for (int p = 0; p < nProcessorsGlobal; ++p)
+        {
+            if (nodeRanks[p] == MPI_UNDEFINED)
+            {
+                continue;
+            }
+            MPI_Aint size;
+            int dispUnit;
+            void *base;
+            MPI_CALL(MPI_Win_shared_query(nodeWindow, nodeRanks[p], &size, &dispUnit, &base));
+            peerDist[p] = static_cast<long long *>(base);
+        }
+
+        windowInSync = false;
+        syncWindowToActual();
+        nodeBarrier();
+    }
+
+    /// @brief Relaxations stored directly into the memory of a process on the same node
+    unsigned long long getNSharedRelaxations() const
     {
-        if (nVerticesGlobal == 0 || lastResponsibleGlobalIdx() < firstResponsibleGlobalIdx || lastResponsibleGlobalIdx() >= nVerticesGlobal || distToRoot.size() != neighOfLocal.size() || distToRoot[0] != INF)
+        unsigned long long total = 0;
+        for (auto n : nSharedRelaxations)
         {
-            throw InvalidData(
-                std::string("Input data invalid! ") + std::to_string(firstResponsibleGlobalIdx) + " " + std::to_string(nLocalResponsible) + " " + std::to_string(nVerticesGlobal) + " " + std::to_string(lastResponsibleGlobalIdx()) + " " + std::to_string(distToRoot.size()) + " " + std::to_string(neighOfLocal.size()) + " " + std::to_string(distToRoot[0]));
+            total += n;
         }
+        return total;
+    }
 
-        int mpi_err = MPI_Win_allocate(
-            winSize, winDisp,
-            MPI_INFO_NULL, MPI_COMM_WORLD, &winMemory, &window);
+    void setCoalescing(bool enable)
+    {
+        coalesce = enable;
+    }
 
-        if (mpi_err != MPI_SUCCESS || window == MPI_WIN_NULL)
+    /// @brief Number of relaxations dropped by sender-side coalescing so far
+    unsigned long long getNCoalesced() const
+    {
+        return nCoalesced;
+    }
+
+    /// @brief Enable the ghost-distance cache for remote neighbours, using at most `budgetBytes` of memory. 0 disables it.
+    void setGhostCacheBudget(size_t budgetBytes)
+    {
+        ghosts.resize(budgetBytes);
+    }
+
+    const GhostCache &getGhostCache() const
+    {
+        return ghosts;
+    }
+
+    unsigned long long getNGhostsRefreshed() const
+    {
+        return nGhostsRefreshed;
+    }
+
+    /// @brief Relax with `n` threads (see `communicateRelax`). The ghost cache is not thread-safe and must stay disabled.
+    /// @throws InvalidData
+    void setThreads(int n)
+    {
+        if (n < 1)
         {
-            throw InvalidData("MPI_Win_allocate failed!");
+            throw InvalidData("Number of threads must be positive!");
+        }
+        if (n > 1 && ghosts.enabled())
+        {
+            throw InvalidData("Ghost cache cannot be shared by relaxation threads!");
         }
+        nThreads = n;
+        threadOutboxes.assign(n - 1, std::vector<std::vector<RelaxMessage>>(nProcessorsGlobal));
+        threadDirty.assign(n, {});
+        nSharedRelaxations.assign(n, 0);
     }
 
-    void freeWindow()
+    int getNThreads() const
     {
-        MPI_Win_free(&window);
+        return nThreads;
     }
 
-    // delete copy constructor and assignment
-    Data(const Data &) = delete;
-    Data &operator=(const Data &) = delete;
-    Data &operator=(Data &&) = delete;
+    /// @brief Pipeline the relaxation step in chunks of `n` active vertices (see `flushChunk`); 0 disables it.
+    /// Collective over all processes.
+    void setChunkSize(size_t n)
+    {
+        chunkSize = n;
+        if (n > 0 && chunkComm == MPI_COMM_NULL)
+        {
+            MPI_CALL(MPI_Comm_dup(MPI_COMM_WORLD, &chunkComm));
+            chunksSentTo.assign(nProcessorsGlobal, 0);
+            chunksReceivedFrom.assign(nProcessorsGlobal, 0);
+        }
+    }
 
-    // allow move constructor
-    Data(Data &&other) noexcept
-        : firstResponsibleGlobalIdx(other.firstResponsibleGlobalIdx),
-          nLocalResponsible(other.nLocalResponsible),
-          nVerticesGlobal(other.nVerticesGlobal),
-          neighOfLocal(std::move(other.neighOfLocal)),
-          distToRoot(std::move(other.distToRoot)),
-          winMemory(other.winMemory),
-          window(other.window),
-          winDisp(other.winDisp),
-          winSize(other.winSize),
-          selfUpdates(std::move(other.selfUpdates))
+    size_t getChunkSize() const
     {
-        other.window = MPI_WIN_NULL;
-        other.winMemory = nullptr;
+        return chunkSize;
     }
 
-    const std::vector<std::vector<std::pair<size_t, long long>>> &getNeigh() const
+    /// @brief Per-owner chunks sent by `flushChunk`, i.e. before the end of their phase
+    unsigned long long getNChunksSent() const
     {
-        return neighOfLocal;
+        return nChunksSent;
     }
 
-    void syncWindowToActual()
+    /// @brief Number of collective calls (fences, all-to-all exchanges) this object has issued
+    unsigned long long getNCollectives() const
     {
-        std::memcpy(winMemory, distToRoot.data(), winSize);
+        return nCollectives;
+    }
+
+    /// @brief Lower cached ghost distances to what their owners currently store. Collective over all processes.
+    /// Owners only ever lower their distances, so a refreshed entry is still a valid upper bound
+    /// even if it becomes stale again right after.
+    void refreshGhosts()
+    {
+        auto &entries = ghosts.entries();
+        std::vector<long long> fetched(entries.size(), INF);
+        syncWindowToActual();
+        fence();
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            if (entries[i].key == GhostCache::EMPTY_KEY)
+            {
+                continue;
+            }
+            VertexRef target{entries[i].key};
+            MPI_CALL(MPI_Get(&fetched[i], 1, MPI_LONG_LONG, target.owner(), target.indexAtOwner(), 1, MPI_LONG_LONG, window));
+        }
+        fence();
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            if (fetched[i] < entries[i].dist)
+            {
+                entries[i].dist = fetched[i];
+                nGhostsRefreshed++;
+            }
+        }
     }
 
     void fence_start()
     {
         // MPI_Win_flush_all(window);
         MPI_CALL(MPI_Win_fence(0, window));
+        nCollectives++;
     }
 
     void fence()
     {
         // MPI_Win_flush_all(window);
         MPI_CALL(MPI_Win_fence(0, window));
+        nCollectives++;
+    }
+
+    /// @brief Open the relaxation step of a phase. Only the window mode needs an access epoch.
+    void beginRelaxations()
+    {
+        windowInSync = false;
+        if (sharedMemory)
+        {
+            // node peers may store into our segment only after we stopped copying into it
+            nodeBarrier();
+        }
+        if (commMode == CommMode::Window)
+        {
+            fence_start();
+        }
+    }
+
+    /// @brief Pipelining (`setChunkSize`): send what the chunk of active vertices just relaxed produced, and apply
+    /// the chunks other processes already sent us. Called by the main thread between chunks of one relaxation step.
+    void flushChunk()
+    {
+        if (nThreads > 1)
+        {
+            mergeThreadOutboxes();
+        }
+        if (!buffersRelaxations())
+        {
+            // window mode issued every relaxation as it happened
+            return;
+        }
+        if (coalesce)
+        {
+            coalesceOutbox();
+        }
+        nChunksSent += sendOutboxChunk();
+        if (commMode != CommMode::Window)
+        {
+            drainChunks();
+        }
+    }
+
+    /// @brief Close the relaxation step of a phase: after this returns, every relaxation
+    /// sent to this process during the phase is reflected in the window memory.
+    void finishRelaxations()
+    {
+        if (sharedMemory)
+        {
+            // every direct store from this node's relaxation step is visible after this
+            nodeBarrier();
+        }
+        if (nThreads > 1)
+        {
+            mergeThreadOutboxes();
+        }
+        if (coalesce)
+        {
+            coalesceOutbox();
+        }
+        if (commMode == CommMode::Window)
+        {
+            if (buffersRelaxations())
+            {
+                accumulateOutbox();
+            }
+            fence();
+            for (auto &msgs : outbox)
+            {
+                msgs.clear();
+            }
+            sending.clear();
+        }
+        else if (chunkSize > 0)
+        {
+            finishChunks();
+        }
+        else
+        {
+            exchangeOutbox();
+        }
     }
 
-    void communicateRelax(long long newDistance, int ownerProcess, int ownerIndex)
+    /// @brief Send one relaxation to the owner of `target`. With several threads, `thread` must be the caller's
+    /// `currentThread()`; distinct threads may call this concurrently.
+    void communicateRelax(long long newDistance, VertexRef target, int thread = 0)
     {
+        auto ownerProcess = target.owner();
+        if (ownerProcess != myRank && ghosts.enabled() && !ghosts.admit(target.bits, newDistance))
+        {
+            return;
+        }
+        if (sharedMemory && peerDist[ownerProcess] != nullptr)
+        {
+            atomicMin(peerDist[ownerProcess] + target.indexAtOwner(), newDistance);
+            nSharedRelaxations[thread]++;
+            return;
+        }
+        if (nThreads > 1 && ownerProcess == myRank && commMode == CommMode::Alltoallv)
+        {
+            // nobody else writes our window in this mode, so own targets skip the buffers
+            auto idx = target.indexAtOwner();
+            if (atomicMinToWin(idx, newDistance))
+            {
+                markDirtyConcurrent(idx, thread);
+            }
+            return;
+        }
+        if (buffersRelaxations())
+        {
+            auto &box = thread == 0 ? outbox : threadOutboxes[thread - 1];
+            box[ownerProcess].push_back({static_cast<long long>(target.indexAtOwner()), newDistance});
+            return;
+        }
         MPI_CALL(MPI_Accumulate(
             &newDistance, 1, MPI_LONG_LONG,
-            ownerProcess, ownerIndex, 1, MPI_LONG_LONG,
+            ownerProcess, target.indexAtOwner(), 1, MPI_LONG_LONG,
             MPI_MIN, window));
     }
 
@@ -168,27 +1361,33 @@ public:
             auto remoteBest = static_cast<long long *>(winMemory)[localIdx];
             if (newDist < remoteBest) {
                 static_cast<long long *>(winMemory)[localIdx] = newDist;
+                markDirty(localIdx);
             }
         }
         selfUpdates.clear();
 
-        for (size_t i = 0; i < nLocalResponsible; ++i)
+        for (auto &found : threadDirty)
         {
-            auto new_dist = static_cast<long long *>(winMemory)[i];
-            if (new_dist > distToRoot[i])
-            {
-                // throw InvalidData("MPI distance relax caused dist to increase!");
-                continue;
-            }
-            else if (new_dist < distToRoot[i])
+            dirty.insert(dirty.end(), found.begin(), found.end());
+            found.clear();
+        }
+
+        if (trackDirty)
+        {
+            auto *winDist = static_cast<long long *>(winMemory);
+            for (auto i : dirty)
             {
-                Update update;
-                update.vGlobalIdx = getFirstResponsibleGlobalIdx() + i;
-                update.prevDist = distToRoot[i];
-                update.newDist = new_dist;
-                updates.push_back(update);
-                distToRoot[i] = new_dist;
+                collectUpdate(i, updates);
+                winDist[i] = distToRoot[i];
+                isDirty[i] = 0;
             }
+            dirty.clear();
+            return updates;
+        }
+
+        for (size_t i = 0; i < nLocalResponsible; ++i)
+        {
+            collectUpdate(i, updates);
         }
         // std::memcpy(distToRoot.data(), winMemory, winSize);
         return updates;
@@ -214,16 +1413,26 @@ public:
         return distToRoot[*locOpt];
     }
 
-    void forEachNeighbor(size_t vGlobalIdx, const std::function<void(size_t, long long)> &visitor) const
+    /// @brief Visit `(target, weight)` of every edge of an owned vertex. Requires `resolveTargets` to have run.
+    template <typename Visitor>
+    void forEachNeighbor(size_t vGlobalIdx, Visitor &&visitor) const
     {
-        auto locOpt = globalToLocalIdx(vGlobalIdx);
-        if (!locOpt.has_value())
+        auto [first, last] = edgeRange(vGlobalIdx);
+        forEachNeighborInRange(first, last, visitor);
+    }
+
+    /// @brief Visit `(target, weight)` of CSR edges `[first, last)`, as returned by `edgeRange`/`firstEdgeNotLighter`.
+    /// The visitor is a template parameter so the per-edge call inlines into the relaxation loops.
+    template <typename Visitor>
+    void forEachNeighborInRange(size_t first, size_t last, Visitor &&visitor) const
+    {
+        if (!targetsResolved)
         {
-            throw InvalidData("Vertex not owned!");
+            throw InvalidData("Edge targets not resolved!");
         }
-        for (const auto &edge : neighOfLocal[*locOpt])
+        for (size_t e = first; e < last; ++e)
         {
-            visitor(edge.first, edge.second);
+            visitor(adjTarget[e], adjWeight[e]);
         }
     }
 
@@ -259,82 +1468,99 @@ public:
             throw InvalidData("Vertex not owned!");
         }
         distToRoot[*locOpt] = dist;
+        windowInSync = false;
+        if (trackDirty)
+        {
+            static_cast<long long *>(winMemory)[*locOpt] = dist;
+        }
+    }
+
+    /// @brief First pass of the two-pass ingestion: count the edge towards the degree of its owned ends.
+    /// Once every edge was counted, `allocateAdjacency` sizes the CSR arrays exactly and a second pass of
+    /// `addEdgeFast` over the same edges fills them, so no per-vertex vectors grow while loading.
+    /// @throws InvalidData
+    void countEdge(size_t u, size_t v)
+    {
+        if (adjacencyAllocated || adjacencyFinalized)
+        {
+            throw InvalidData("Cannot count edges after adjacency was allocated!");
+        }
+        if (!acceptEdge(u, v, 0))
+        {
+            return;
+        }
+        if (adjOffsets.empty())
+        {
+            adjOffsets.assign(nLocalResponsible + 1, 0);
+        }
+        if (isOwned(u))
+        {
+            adjOffsets[*globalToLocalIdx(u) + 1]++;
+        }
+        if (isOwned(v))
+        {
+            adjOffsets[*globalToLocalIdx(v) + 1]++;
+        }
+    }
+
+    /// @brief End the counting pass: allocate the CSR arrays for exactly the counted edges.
+    void allocateAdjacency()
+    {
+        if (adjacencyAllocated || adjacencyFinalized)
+        {
+            throw InvalidData("Adjacency already allocated!");
+        }
+        if (adjOffsets.empty())
+        {
+            adjOffsets.assign(nLocalResponsible + 1, 0);
+        }
+        std::partial_sum(adjOffsets.begin(), adjOffsets.end(), adjOffsets.begin());
+        adjTarget.resize(adjOffsets.back());
+        adjWeight.resize(adjOffsets.back());
+        adjLightEnd.assign(adjOffsets.begin(), adjOffsets.end() - 1);
+        std::vector<std::vector<std::pair<size_t, long long>>>().swap(neighOfLocal);
+        adjacencyBytesBefore = adjOffsets.capacity() * sizeof(size_t) + adjTarget.capacity() * sizeof(VertexRef) + adjWeight.capacity() * sizeof(long long) + adjLightEnd.capacity() * sizeof(size_t);
+        adjacencyAllocated = true;
     }
 
     /// @brief Add new edge to stored data if responsible for any of the end vertices. Ignore if not owned!
+    /// After `allocateAdjacency`, the edge must be one of those counted.
     /// @throws InvalidData
     void addEdgeFast(size_t u, size_t v, size_t weight)
     {
-        if (u == v)
+        if (adjacencyFinalized)
         {
-            return;
+            throw InvalidData("Cannot add edges after adjacency was finalized!");
         }
-        if (u >= nVerticesGlobal || v >= nVerticesGlobal)
+        if (!acceptEdge(u, v, weight))
         {
-            throw InvalidData(
-                std::string("Invalid edge data!") + std::to_string(u) + " " + std::to_string(v) + " " + std::to_string(weight));
+            return;
         }
 
-        if (!isOwned(u) && !isOwned(v))
+        if (!adjacencyAllocated && neighOfLocal.empty())
         {
-            throw InvalidData("Neither of edge ends owned!");
+            neighOfLocal.resize(nLocalResponsible);
         }
         if (isOwned(u))
         {
-            auto &neighbors = neighOfLocal[*globalToLocalIdx(u)];
-            // auto it = std::find_if(neighbors.begin(), neighbors.end(),
-            //                        [v](const std::pair<uint64_t, uint8_t> &p)
-            //                        { return p.first == v; });
-
-            // if (it == neighbors.end())
-            // {
-            neighbors.push_back({v, weight});
-            // }
-            // else if (weight < it->second)
-            // {
-            //     it->second = weight;
-            // }
+            placeEdge(*globalToLocalIdx(u), v, weight);
         }
         if (isOwned(v))
         {
-            auto &neighbors = neighOfLocal[*globalToLocalIdx(v)];
-            // auto it = std::find_if(neighbors.begin(), neighbors.end(),
-            //                        [u](const std::pair<uint64_t, uint8_t> &p)
-            //                        { return p.first == u; });
-
-            // if (it == neighbors.end())
-            // {
-            neighbors.push_back({u, weight});
-            // }
-            // else if (weight < it->second)
-            // {
-            // it->second = weight;
-            // }
+            placeEdge(*globalToLocalIdx(v), u, weight);
         }
     }
 
+    /// @brief Keep only the lightest of parallel edges. `finalizeAdjacency(true)` does the same while building the CSR.
     void trimMultiEdges()
     {
+        if (adjacencyAllocated)
+        {
+            throw InvalidData("Use finalizeAdjacency(true) to trim an allocated adjacency!");
+        }
         for (auto &neighbors : neighOfLocal)
         {
-            std::unordered_map<size_t, long long> deduped;
-
-            for (const auto &[target, weight] : neighbors)
-            {
-                auto it = deduped.find(target);
-                if (it == deduped.end() || weight < it->second)
-                {
-                    deduped[target] = weight;
-                }
-            }
-
-            neighbors.clear();
-            neighbors.reserve(deduped.size());
-
-            for (const auto &[target, weight] : deduped)
-            {
-                neighbors.emplace_back(target, weight);
-            }
+            dedupeByTarget(neighbors);
         }
     }
 
@@ -344,7 +1570,23 @@ public:
     }
 };
 
+/// @brief Load the graph part of one process from `input_filename`: either the text format (`N first last` then
+/// `u v w` lines) or, detected by its magic, the binary format of `BinaryGraphHeader`.
 std::optional<Data> process_input_and_load_graph_from_stream(
     int myRank,
     const std::string &input_filename,
-    bool assume_nomultiedge);
\ No newline at end of file
+    bool assume_nomultiedge);
+
+/// @brief Load the graph part of one process straight from the Graph500 generator output in `edges_folder`
+/// (`edges.out`: 6-byte packed vertex pairs, `edges.out.weights`: one float per edge), block-distributing
+/// `2^scale` vertices over all processes. Collective: every rank reads a contiguous slice of the edges with
+/// `MPI_File_read_at_all` and an all-to-all sends each edge to the owners of both its ends.
+std::optional<Data> load_graph500_edges(
+    int myRank,
+    const std::string &edges_folder,
+    int scale,
+    bool assume_nomultiedge);
+
+/// @brief Write the (finalized) adjacency of `data` in the `BinaryGraphHeader` format.
+/// Targets are written resolved if `resolveTargets` already ran for a distribution over `nProcessors` processes.
+bool save_graph_binary(const Data &data, const std::string &output_filename, size_t nProcessors);
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <mpi.h>
+#include <algorithm>
+#include <limits>
+
+#include "logger.hpp"
+
+/// @brief Control values every process contributes at the end of a phase, reduced together by one collective.
+struct ControlState
+{
+    /// @brief vertices that are active in the current bucket for the next phase (summed)
+    long long nActive;
+    /// @brief smallest non-empty bucket after the current one (minimum)
+    long long minBucket;
+    /// @brief vertices in the current bucket (summed)
+    long long nSettled;
+};
+
+/// @brief Fused Allreduce of `ControlState` with a custom operation.
+/// In non-blocking mode the reduction is started with `MPI_Iallreduce` and local work overlaps it.
+class ControlReduction
+{
+    MPI_Datatype type;
+    MPI_Op op;
+    bool nonBlocking;
+    ControlState global;
+    unsigned long long nReductions;
+
+    static void combine(void *in, void *inout, int *len, MPI_Datatype *)
+    {
+        auto *a = static_cast<const ControlState *>(in);
+        auto *b = static_cast<ControlState *>(inout);
+        for (int i = 0; i < *len; ++i)
+        {
+            b[i].nActive += a[i].nActive;
+            b[i].minBucket = std::min(b[i].minBucket, a[i].minBucket);
+            b[i].nSettled += a[i].nSettled;
+        }
+    }
+
+public:
+    explicit ControlReduction(bool nonBlocking_)
+        : type(MPI_DATATYPE_NULL),
+          op(MPI_OP_NULL),
+          nonBlocking(nonBlocking_),
+          global{0, std::numeric_limits<long long>::max(), 0},
+          nReductions(0)
+    {
+        static_assert(sizeof(ControlState) == 3 * sizeof(long long), "ControlState must be three packed long longs");
+        MPI_CALL(MPI_Type_contiguous(3, MPI_LONG_LONG, &type));
+        MPI_CALL(MPI_Type_commit(&type));
+        MPI_CALL(MPI_Op_create(&ControlReduction::combine, 1, &op));
+    }
+
+    ControlReduction(const ControlReduction &) = delete;
+    ControlReduction &operator=(const ControlReduction &) = delete;
+
+    ~ControlReduction()
+    {
+        MPI_Op_free(&op);
+        MPI_Type_free(&type);
+    }
+
+    /// @brief Reduce `local` over all processes. `overlapped` runs while the reduction is in flight
+    /// (or before it, in blocking mode); it must not depend on the result.
+    template <typename Fn>
+    const ControlState &reduce(const ControlState &local, Fn &&overlapped)
+    {
+        nReductions++;
+        if (nonBlocking)
+        {
+            MPI_Request request;
+            MPI_CALL(MPI_Iallreduce(&local, &global, 1, type, op, MPI_COMM_WORLD, &request));
+            overlapped();
+            MPI_CALL(MPI_Wait(&request, MPI_STATUS_IGNORE));
+        }
+        else
+        {
+            overlapped();
+            MPI_CALL(MPI_Allreduce(&local, &global, 1, type, op, MPI_COMM_WORLD));
+        }
+        return global;
+    }
+
+    /// @returns result of the last reduction
+    const ControlState &last() const
+    {
+        return global;
+    }
+
+    unsigned long long getNReductions() const
+    {
+        return nReductions;
+    }
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "common.hpp"
+#include "parse_data.hpp"
+
+/// @brief Which edges of an active vertex a phase relaxes.
+/// With IOS, the short phases relax only inner short edges (those whose target stays in the current bucket)
+/// and the single long phase relaxes the rest. Without IOS (and in Bellman-Ford) every phase relaxes all edges.
+/// The relaxation kernels take it as a template parameter, so each mode gets its own loop with no per-edge dispatch.
+enum class EdgeSubset
+{
+    All,
+    InnerShort,
+    Long
+};
+
+/// @brief Edges of a vertex at distance `uDist` in bucket `currentK` lighter than this are inner short:
+/// `weight < delta` and `uDist + weight` still in bucket `currentK`.
+inline long long innerShortBound(long long uDist, long long currentK, long long delta_val)
+{
+    return std::min(delta_val, (currentK + 1) * delta_val - uDist);
+}
+
+/// @brief CSR edge range `[first, last)` of vertex `uGlobalIdx` selected by `subset`.
+/// Adds the relaxations it implies to `nShort` / `nLong`.
+template <EdgeSubset subset>
+std::pair<size_t, size_t> selectEdges(
+    const Data &data, size_t uGlobalIdx, long long uDist, long long currentK, long long delta_val,
+    unsigned long long &nShort, unsigned long long &nLong)
+{
+    auto [first, last] = data.edgeRange(uGlobalIdx);
+    auto split = data.firstEdgeNotLighter(uGlobalIdx, innerShortBound(uDist, currentK, delta_val));
+    if constexpr (subset == EdgeSubset::InnerShort)
+    {
+        nShort += split - first;
+        return {first, split};
+    }
+    else if constexpr (subset == EdgeSubset::Long)
+    {
+        nLong += last - split;
+        return {split, last};
+    }
+    else
+    {
+        nShort += split - first;
+        nLong += last - split;
+        return {first, last};
+    }
+}
+
+/// @brief The relaxation loop of `relaxAllEdges`, also timed by `bench_relax`: for the `subset` edges of active
+/// vertices `[begin, end)`, call `relax(target, newDist, thread)`. Edges whose sum would overflow are skipped (a
+/// label-correcting step may relax a vertex close to `INF` that is not final yet). With `data.getNThreads() > 1`
+/// the vertices are split among OpenMP threads and `relax` must be safe to call from all of them.
+/// @returns false if an active vertex had no distance
+template <EdgeSubset subset, typename Relax>
+bool relaxActiveRange(
+    const Data &data,
+    const std::vector<size_t> &activeSet,
+    size_t begin,
+    size_t end,
+    long long currentK,
+    long long delta_val,
+    unsigned long long &nShortOut,
+    unsigned long long &nLongOut,
+    Relax &&relax)
+{
+    unsigned long long nShort = 0, nLong = 0;
+    bool enteredInf = false;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64) reduction(+ : nShort, nLong) reduction(|| : enteredInf) if (data.getNThreads() > 1)
+#endif
+    for (size_t i = begin; i < end; ++i)
+    {
+        auto u_global_id = activeSet[i];
+        auto u_dist = data.getDist(u_global_id);
+        if (u_dist == INF)
+        {
+            enteredInf = true;
+            continue;
+        }
+
+        auto thread = currentThread();
+        auto [first, last] = selectEdges<subset>(data, u_global_id, u_dist, currentK, delta_val, nShort, nLong);
+        data.forEachNeighborInRange(first, last, [&](VertexRef v, long long w)
+        {
+            if (w >= INF - u_dist)
+            {
+                return;
+            }
+            relax(v, u_dist + w, thread);
+        });
+    }
+    nShortOut += nShort;
+    nLongOut += nLong;
+    return !enteredInf;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <mpi.h>
+#include <charconv>
+#include <limits>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "logger.hpp"
+
+/// @brief Where the final distances are written.
+/// `PerRank`: every process writes its own text file, one distance per line (the layout the tests compare).
+/// `Shared`: one text file holding the per-rank blocks in rank order (= global vertex order), written collectively.
+/// `Binary`: one file of native-endian `int64` distances indexed by global vertex id.
+/// Unreachable vertices are written as -1 in every mode.
+enum class OutputMode
+{
+    PerRank,
+    Shared,
+    Binary
+};
+
+/// @brief Format `n` distances one per line into a single buffer; `INF` becomes -1.
+inline std::string formatDistances(const long long *dist, size_t n)
+{
+    constexpr size_t MAX_LINE = 21; // sign, 19 digits, newline
+    std::string text(n * MAX_LINE, '\0');
+    char *p = text.data();
+    for (size_t i = 0; i < n; ++i)
+    {
+        auto d = dist[i] == std::numeric_limits<long long>::max() ? -1 : dist[i];
+        p = std::to_chars(p, p + MAX_LINE - 1, d).ptr;
+        *p++ = '\n';
+    }
+    text.resize(p - text.data());
+    return text;
+}
+
+/// @brief Collectively write `bytes` at `offset` of `filename`, which ends up exactly `totalBytes` long.
+/// Writes go in rounds of at most `CHUNK` bytes so counts fit in an `int`; every process runs the same rounds.
+inline bool writeAtAll(const std::string &filename, unsigned long long offset, const char *buf, unsigned long long bytes,
+                       unsigned long long totalBytes)
+{
+    constexpr unsigned long long CHUNK = 1ULL << 30;
+    unsigned long long maxBytes = 0;
+    MPI_CALL(MPI_Allreduce(&bytes, &maxBytes, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, MPI_COMM_WORLD));
+
+    MPI_File fh;
+    if (MPI_File_open(MPI_COMM_WORLD, filename.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+    {
+        return false;
+    }
+    // drops the tail of an older, longer file
+    bool ok = MPI_File_set_size(fh, static_cast<MPI_Offset>(totalBytes)) == MPI_SUCCESS;
+    for (unsigned long long done = 0; done < maxBytes; done += CHUNK)
+    {
+        auto count = done < bytes ? std::min(CHUNK, bytes - done) : 0;
+        ok = MPI_File_write_at_all(fh, static_cast<MPI_Offset>(offset + done), buf + std::min(done, bytes),
+                                   static_cast<int>(count), MPI_BYTE, MPI_STATUS_IGNORE) == MPI_SUCCESS &&
+             ok;
+    }
+    return MPI_File_close(&fh) == MPI_SUCCESS && ok;
+}
+
+/// @brief `OutputMode::Shared`: offsets of the text blocks come from an exclusive prefix sum of their lengths.
+inline bool writeDistancesShared(const std::string &filename, const long long *dist, size_t n)
+{
+    auto text = formatDistances(dist, n);
+    unsigned long long bytes = text.size(), offset = 0, totalBytes = 0;
+    int myRank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+    MPI_CALL(MPI_Exscan(&bytes, &offset, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD));
+    if (myRank == 0)
+    {
+        offset = 0; // MPI_Exscan leaves rank 0's result undefined
+    }
+    MPI_CALL(MPI_Allreduce(&bytes, &totalBytes, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD));
+    return writeAtAll(filename, offset, text.data(), bytes, totalBytes);
+}
+
+/// @brief `OutputMode::Binary`: every record has a fixed size, so the offset is the first owned global index.
+inline bool writeDistancesBinary(const std::string &filename, const long long *dist, size_t n,
+                                 size_t firstGlobalIdx, size_t nVerticesGlobal)
+{
+    std::vector<long long> values(dist, dist + n);
+    std::replace(values.begin(), values.end(), std::numeric_limits<long long>::max(), -1LL);
+    return writeAtAll(filename, firstGlobalIdx * sizeof(long long), reinterpret_cast<const char *>(values.data()),
+                      n * sizeof(long long), nVerticesGlobal * sizeof(long long));
+}
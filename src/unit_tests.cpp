@@ -1,7 +1,19 @@
+#include <iostream>
+#include <algorithm>
 #include "block_dist.hpp"
+#include "buckets.hpp"
+#include "result_writer.hpp"
+#include "hybridization.hpp"
+#include "delta_selection.hpp"
+#include "async_relax.hpp"
+#include "ghost_cache.hpp"
 
 const bool VERBOSE = false;
 
+void logError(const std::string &msg) {
+    std::cerr << msg << "\n";
+}
+
 bool testBlockDist() {
     // test trivial distribution
     {
@@ -204,8 +216,266 @@ bool testBlockDist() {
     return true;
 }
 
+bool testBucketQueue() {
+    // empty queue
+    {
+        BucketQueue buckets(100, 10, 4);
+        if (buckets.minBucket() != BucketQueue::NONE) { logError("Empty queue should have no min bucket!"); return false; }
+        if (buckets.size(0) != 0) { logError("Empty queue should have empty buckets!"); return false; }
+        if (buckets.bucketOfVertex(105) != BucketQueue::NONE) { logError("Vertex shouldn't be queued!"); return false; }
+    }
+    // ownership
+    {
+        BucketQueue buckets(100, 10, 4);
+        try {
+            buckets.moveTo(99, 0);
+            logError("Shouldn't accept vertex not owned!"); return false;
+        } catch (const BucketQueue::InvalidBucket& e) {
+        }
+        try {
+            buckets.moveTo(110, 0);
+            logError("Shouldn't accept vertex not owned!"); return false;
+        } catch (const BucketQueue::InvalidBucket& e) {
+        }
+    }
+    // moving between buckets inside the ring
+    {
+        BucketQueue buckets(100, 10, 4);
+        buckets.moveTo(100, 2);
+        buckets.moveTo(101, 2);
+        buckets.moveTo(102, 3);
+        if (buckets.minBucket() != 2) { logError("Invalid min bucket!"); return false; }
+        if (buckets.size(2) != 2) { logError("Invalid bucket size!"); return false; }
+        buckets.moveTo(100, 1);
+        if (buckets.minBucket() != 1) { logError("Invalid min bucket!"); return false; }
+        if (buckets.size(2) != 1) { logError("Vertex not removed from old bucket!"); return false; }
+        if (buckets.vertices(2) != std::vector<size_t>{101}) { logError("Wrong vertex left in old bucket!"); return false; }
+        if (buckets.bucketOfVertex(100) != 1) { logError("Invalid tracked bucket!"); return false; }
+        buckets.clear(1);
+        if (buckets.bucketOfVertex(100) != BucketQueue::NONE) { logError("Cleared vertex still queued!"); return false; }
+        if (buckets.minBucket() != 2) { logError("Invalid min bucket after clear!"); return false; }
+        if (buckets.totalQueued() != 2) { logError("Invalid number of queued vertices!"); return false; }
+    }
+    // buckets beyond the ring wait in overflow until the ring drains
+    {
+        BucketQueue buckets(0, 10, 4);
+        buckets.moveTo(0, 0);
+        buckets.moveTo(1, 9);
+        buckets.moveTo(2, 13);
+        buckets.moveTo(3, 9);
+        if (buckets.minBucket() != 0) { logError("Invalid min bucket!"); return false; }
+        if (buckets.size(9) != 2) { logError("Invalid overflow bucket size!"); return false; }
+        buckets.clear(0);
+        if (buckets.minBucket() != 9) { logError("Ring should restart at overflow minimum!"); return false; }
+        auto nine = buckets.vertices(9);
+        std::sort(nine.begin(), nine.end());
+        if (nine != std::vector<size_t>{1, 3}) { logError("Invalid vertices of bucket 9!"); return false; }
+        buckets.clear(9);
+        if (buckets.minBucket() != 13) { logError("Invalid min bucket!"); return false; }
+        buckets.clear(13);
+        if (buckets.minBucket() != BucketQueue::NONE) { logError("Queue should be empty!"); return false; }
+    }
+    // next bucket after the current one, without moving the ring
+    {
+        BucketQueue buckets(0, 10, 4);
+        buckets.moveTo(0, 1);
+        buckets.moveTo(1, 2);
+        buckets.moveTo(2, 9);
+        buckets.moveTo(3, 7);
+        if (buckets.minBucketAfter(1) != 2) { logError("Invalid next bucket in ring!"); return false; }
+        if (buckets.minBucketAfter(2) != 7) { logError("Invalid next bucket in overflow!"); return false; }
+        buckets.moveTo(3, 8);
+        if (buckets.minBucketAfter(2) != 8) { logError("Overflow minimum not updated after move!"); return false; }
+        if (buckets.minBucketAfter(8) != 9) { logError("Invalid next bucket inside overflow range!"); return false; }
+        if (buckets.minBucketAfter(9) != BucketQueue::NONE) { logError("Nothing should follow the last bucket!"); return false; }
+        if (buckets.minBucket() != 1) { logError("minBucketAfter shouldn't move the ring!"); return false; }
+    }
+    // going below the ring base and collapsing everything into one bucket
+    {
+        BucketQueue buckets(0, 10, 4);
+        buckets.moveTo(5, 20);
+        if (buckets.minBucket() != 20) { logError("Invalid min bucket!"); return false; }
+        buckets.moveTo(6, 3);
+        if (buckets.minBucket() != 3) { logError("Invalid min bucket below base!"); return false; }
+        if (buckets.bucketOfVertex(5) != 20) { logError("Rebase lost a vertex!"); return false; }
+        buckets.moveTo(7, 40);
+        buckets.mergeAllInto(0);
+        if (buckets.minBucket() != 0) { logError("Invalid min bucket after merge!"); return false; }
+        if (buckets.size(0) != 3) { logError("Merge lost vertices!"); return false; }
+        if (buckets.size(20) != 0 || buckets.size(40) != 0) { logError("Merge left vertices behind!"); return false; }
+        // and spreading them out again
+        buckets.requeueAll([](size_t v) { return static_cast<long long>(v) * 10; });
+        if (buckets.minBucket() != 50) { logError("Invalid min bucket after requeue!"); return false; }
+        if (buckets.size(0) != 0 || buckets.bucketOfVertex(7) != 70) { logError("Requeue misplaced vertices!"); return false; }
+        if (buckets.minBucketAfter(50) != 60 || buckets.totalQueued() != 3) { logError("Requeue lost vertices!"); return false; }
+    }
+    // test visiting ring and overflow vertices
+    {
+        BucketQueue buckets(100, 10, 4);
+        buckets.moveTo(101, 1);
+        buckets.moveTo(102, 2);
+        buckets.moveTo(103, 50);
+        long long bucketSum = 0;
+        size_t vertexSum = 0;
+        buckets.forEachQueued([&](size_t v, long long bucket) { vertexSum += v; bucketSum += bucket; });
+        if (vertexSum != 306 || bucketSum != 53) { logError("forEachQueued missed vertices!"); return false; }
+    }
+
+    std::cerr << "BucketQueue test successfull!\n";
+    return true;
+}
+
+bool testFormatDistances() {
+    {
+        if (!formatDistances(nullptr, 0).empty()) { logError("Empty input should format to nothing!"); return false; }
+    }
+    {
+        const long long dist[] = {0, 7, std::numeric_limits<long long>::max(), std::numeric_limits<long long>::max() - 1};
+        auto text = formatDistances(dist, 4);
+        if (text != "0\n7\n-1\n9223372036854775806\n") { logError("Invalid formatted distances: " + text); return false; }
+    }
+
+    std::cerr << "formatDistances test successfull!\n";
+    return true;
+}
+
+bool testHybridizationModel() {
+    const double phaseCost = HybridizationModel::DEFAULT_PHASE_COST;
+    // synchronisation-bound tail: few vertices settle per epoch, phases cost far more than relaxations
+    {
+        HybridizationModel model(4, 2, phaseCost);
+        if (model.shouldSwitchToBellmanFord(1000).switchNow) { logError("Switched without any epoch observed!"); return false; }
+        model.recordEpoch({10, 10, 40});
+        model.recordEpoch({10, 10, 40});
+        auto decision = model.shouldSwitchToBellmanFord(1000);
+        if (!decision.switchNow || decision.reason.empty()) { logError("Should switch to Bellman-Ford!"); return false; }
+        if (model.shouldSwitchToBellmanFord(0).switchNow) { logError("Nothing is left to relax!"); return false; }
+    }
+    // the same epochs with phases as cheap as a relaxation, or on a single process where they synchronise nothing:
+    // Bellman-Ford would only add relaxations
+    for (auto [nProcesses, cost] : {std::pair{2.0, 1.0}, std::pair{1.0, phaseCost}}) {
+        HybridizationModel model(4, nProcesses, cost);
+        model.recordEpoch({10, 10, 40});
+        model.recordEpoch({10, 10, 40});
+        if (model.shouldSwitchToBellmanFord(1000).switchNow) { logError("Cheap phases shouldn't switch!"); return false; }
+    }
+    // compute-bound: many vertices settle per phase
+    {
+        HybridizationModel model(4, 2, phaseCost);
+        model.recordEpoch({2, 1000, 4000});
+        model.recordEpoch({2, 1000, 4000});
+        if (model.shouldSwitchToBellmanFord(1000).switchNow) { logError("Shouldn't switch to Bellman-Ford!"); return false; }
+    }
+    // a Bellman-Ford frontier that keeps growing sends it back after `PATIENCE` phases, a shrinking one does not
+    {
+        HybridizationModel model(16, 2, phaseCost);
+        model.recordEpoch({2, 1000, 4000});
+        model.recordEpoch({2, 1000, 4000});
+        model.switched();
+        if (model.shouldSwitchBack({1000, 4000, 5000}).switchNow) { logError("Switched back too early!"); return false; }
+        if (!model.shouldSwitchBack({4000, 4000, 5000}).switchNow) { logError("Should switch back!"); return false; }
+        model.switched();
+        if (model.shouldSwitchToBellmanFord(1000).switchNow) { logError("Switched again during warm-up!"); return false; }
+        if (model.shouldSwitchBack({1000, 10, 5000}).switchNow || model.shouldSwitchBack({10, 1, 5000}).switchNow) {
+            logError("Shrinking frontier shouldn't switch back!"); return false;
+        }
+    }
+
+    std::cerr << "HybridizationModel test successfull!\n";
+    return true;
+}
+
+bool testChooseDelta() {
+    // uniform weights 0..255 at average degree 32 give the classic W / d
+    {
+        double logSum = 0;
+        for (int w = 0; w <= 255; ++w) { logSum += std::log1p(w); }
+        auto choice = chooseDelta({256 * 1000, logSum * 1000, 255, 40}, 256 * 1000 / 32, 10);
+        if (choice.delta != 8 || choice.reason.empty()) { logError("Invalid auto delta: " + std::to_string(choice.delta)); return false; }
+    }
+    // one huge edge among many light ones hardly matters; delta never exceeds the heaviest edge
+    {
+        auto choice = chooseDelta({10000, 9998 * std::log1p(9) + 2 * std::log1p(1e18), 1e18, 2}, 5000, 10);
+        if (choice.delta < 10 || choice.delta > 20) { logError("Outlier moved auto delta: " + std::to_string(choice.delta)); return false; }
+        if (chooseDelta({4, 4 * std::log1p(1000), 1000, 2}, 100, 10).delta != 1001) { logError("Auto delta should be capped!"); return false; }
+        if (chooseDelta({4, 0, 0, 2}, 2, 10).delta != 1) { logError("Auto delta should be at least 1!"); return false; }
+        if (chooseDelta({0, 0, 0, 0}, 5, 10).delta != 10) { logError("Edgeless graph should keep the default!"); return false; }
+    }
+
+    std::cerr << "chooseDelta test successfull!\n";
+    return true;
+}
+
+bool testDeltaAdaptation() {
+    DeltaAdaptation adaptation(8);
+    // thin bucket, every vertex relaxed once: widen
+    if (adaptation.next(2, 100, 100) != 16) { logError("Thin bucket should widen delta!"); return false; }
+    // in between: keep
+    if (adaptation.next(5, 130, 100) != 16) { logError("Delta should stay!"); return false; }
+    // wasteful bucket: narrow, and never widen back to the width that wasted
+    if (adaptation.next(3, 300, 100) != 8) { logError("Wasteful bucket should narrow delta!"); return false; }
+    if (adaptation.next(1, 100, 100) != 8) { logError("Delta shouldn't reach the wasteful width again!"); return false; }
+    if (adaptation.next(1, 100, 0) != 8) { logError("Empty bucket shouldn't change delta!"); return false; }
+    if (adaptation.getNChanges() != 2 || adaptation.getMinDelta() != 8 || adaptation.getMaxDelta() != 16) {
+        logError("Invalid adaptation summary!"); return false;
+    }
+    DeltaAdaptation narrowest(1);
+    if (narrowest.next(10, 500, 100) != 1) { logError("Delta can't go below 1!"); return false; }
+
+    std::cerr << "DeltaAdaptation test successfull!\n";
+    return true;
+}
+
+bool testTerminationDetector() {
+    TerminationDetector detector;
+    // the first wave can't decide on its own, even if it looks quiet
+    if (detector.observe({5, 5, 0, 0})) { logError("Single wave shouldn't terminate!"); return false; }
+    // a batch was exchanged between the waves
+    if (detector.observe({6, 6, 0, 0})) { logError("Changed counters shouldn't terminate!"); return false; }
+    // a batch is in flight
+    if (detector.observe({7, 6, 0, 0})) { logError("Batch in flight shouldn't terminate!"); return false; }
+    if (detector.observe({7, 6, 0, 0})) { logError("Batch in flight shouldn't terminate!"); return false; }
+    // it arrived and created work
+    if (detector.observe({7, 7, 1, 3})) { logError("Busy process shouldn't terminate!"); return false; }
+    if (!detector.observe({7, 7, 0, 3})) { logError("Two equal quiet waves should terminate!"); return false; }
+
+    std::cerr << "TerminationDetector test successfull!\n";
+    return true;
+}
+
+bool testGhostCache() {
+    GhostCache cache;
+    cache.resize(sizeof(GhostCache::Entry));
+    if (cache.enabled()) { logError("A single slot should disable the cache!"); return false; }
+    cache.resize(2 * sizeof(GhostCache::Entry));
+    if (!cache.enabled() || cache.entries().size() != 2) { logError("Two slots should fit!"); return false; }
+    cache.resize(1000 * sizeof(GhostCache::Entry));
+    if (cache.entries().size() != 512) { logError("Capacity should round down to a power of two!"); return false; }
+
+    if (!cache.admit(7, 10)) { logError("First relaxation should be sent!"); return false; }
+    if (cache.admit(7, 10)) { logError("Equal distance shouldn't be sent!"); return false; }
+    if (!cache.admit(7, 9)) { logError("Better distance should be sent!"); return false; }
+
+    // consecutive keys, as the vertices of one remote block, should spread over the table
+    size_t filled = 0;
+    cache.resize(512 * sizeof(GhostCache::Entry));
+    for (uint64_t key = 1000; key < 1512; ++key) { cache.admit(key, 1); }
+    for (const auto &entry : cache.entries()) { filled += entry.key != GhostCache::EMPTY_KEY; }
+    if (filled < 400) { logError("Consecutive keys collide too often: " + std::to_string(filled) + " of 512 slots used!"); return false; }
+
+    std::cerr << "GhostCache test successfull!\n";
+    return true;
+}
+
 int main() {
     if (!testBlockDist()) { return 1; }
+    if (!testBucketQueue()) { return 1; }
+    if (!testFormatDistances()) { return 1; }
+    if (!testHybridizationModel()) { return 1; }
+    if (!testChooseDelta()) { return 1; }
+    if (!testDeltaAdaptation()) { return 1; }
+    if (!testTerminationDetector()) { return 1; }
+    if (!testGhostCache()) { return 1; }
     
     return 0;
 }
\ No newline at end of file
@@ -38,7 +38,9 @@ def run_tests(break_on_fail, local):
                     command = "mpiexec"
                 else:
                     command = "srun"
-                execution = subprocess.run([command, "-n", str(workers), "./test_command.sh", solution.name, test.name], capture_output=True, timeout=600)
+                # a test may pin its delta and options (e.g. a regression of an optional mode) in a `flags` file
+                flags = (test / "flags").read_text().split() if (test / "flags").exists() else []
+                execution = subprocess.run([command, "-n", str(workers), "./test_command.sh", solution.name, test.name] + flags, capture_output=True, timeout=600)
                 if execution.returncode != 0:
                     print(f"    {test.name}: FAILED ({command})" + execution.stdout.decode('UTF-8') + "ERR:" + execution.stderr.decode('UTF-8'))
                     if break_on_fail: